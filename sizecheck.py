@@ -0,0 +1,48 @@
+Import("env")
+
+import glob
+import os
+import subprocess
+
+# per-object size report for the app, and a hard budget on the linked image
+# - budgets are set with custom_ram_budget / custom_flash_budget in platformio.ini
+
+def object_sizes(size_tool, objects):
+    out = subprocess.check_output([size_tool, "--format=berkeley"] + objects).decode()
+    rows = []
+    for line in out.splitlines()[1:]:
+        fields = line.split()
+        if len(fields) < 6:
+            continue
+        text, data, bss = (int(f) for f in fields[:3])
+        rows.append((text, data, bss, fields[5]))
+    return rows
+
+def size_check(source, target, env):
+    size_tool = env.subst("$SIZETOOL") or "avr-size"
+    build_dir = env.subst("$BUILD_DIR")
+    elf = str(target[0])
+
+    objects = sorted(glob.glob(os.path.join(build_dir, "**", "*.o"), recursive=True))
+    if objects:
+        print("%8s %8s %8s  %s" % ("text", "data", "bss", "object"))
+        for text, data, bss, name in sorted(object_sizes(size_tool, objects), key=lambda r: r[1] + r[2], reverse=True):
+            print("%8d %8d %8d  %s" % (text, data, bss, os.path.relpath(name, build_dir)))
+
+    text, data, bss, _ = object_sizes(size_tool, [elf])[0]
+    ram = data + bss
+    flash = text + data
+    ram_budget = int(env.GetProjectOption("custom_ram_budget", "0"), 0)
+    flash_budget = int(env.GetProjectOption("custom_flash_budget", "0"), 0)
+
+    print("RAM:   %6d / %6d bytes (.data + .bss)" % (ram, ram_budget))
+    print("Flash: %6d / %6d bytes (.text + .data)" % (flash, flash_budget))
+
+    if ram_budget and ram > ram_budget:
+        print("Error: RAM budget exceeded by %d bytes" % (ram - ram_budget))
+        env.Exit(1)
+    if flash_budget and flash > flash_budget:
+        print("Error: Flash budget exceeded by %d bytes" % (flash - flash_budget))
+        env.Exit(1)
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", size_check)
@@ -0,0 +1,114 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Arpeggiator note set
+ *
+ * Held keys are kept sorted, and in the order they were pressed, as they go
+ * down and up - nothing rescans the keyboard. Next() walks the set once per
+ * step, across the octave range, and returns semitones above the low C key;
+ * the engine turns those into pitch.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+enum ArpOrder : uint8_t {
+  ARP_UP,
+  ARP_DOWN,
+  ARP_UPDOWN, // ends aren't repeated
+  ARP_RANDOM,
+  ARP_PLAYED, // in the order the keys went down
+
+  ARP_ORDER_COUNT
+};
+
+struct Arp {
+  static constexpr uint8_t MAX_NOTES = 13; // one octave of keys, C to C
+  static constexpr uint8_t MAX_OCTAVES = 3;
+  static constexpr uint8_t NO_NOTE = 0xff;
+
+  ArpOrder order = ARP_UP;
+  uint8_t octaves = 1; // 1-3
+
+  uint8_t sorted_[MAX_NOTES]; // semitones, ascending
+  uint8_t played_[MAX_NOTES]; // semitones, oldest first
+  uint8_t count_ = 0;
+
+  uint8_t pos_ = 0;    // index into the walk, count_ * octaves long
+  bool down_ = false;  // up-down direction
+  bool fresh_ = true;  // next step plays pos_ without moving
+
+  uint8_t count() const { return count_; }
+  uint8_t span() const { return count_ * octaves; }
+
+  void Press(uint8_t semi) {
+    if (count_ >= MAX_NOTES) return;
+    for (uint8_t i = 0; i < count_; ++i) {
+      if (sorted_[i] == semi) return; // already held
+    }
+    uint8_t i = count_;
+    for (; i > 0 && sorted_[i - 1] > semi; --i) sorted_[i] = sorted_[i - 1];
+    sorted_[i] = semi;
+    played_[count_] = semi;
+    if (count_++ == 0) Restart();
+  }
+  void Release(uint8_t semi) {
+    if (!Remove(sorted_, semi)) return;
+    Remove(played_, semi);
+    --count_;
+    if (pos_ >= span()) pos_ = 0;
+  }
+  void Clear() {
+    count_ = 0;
+    Restart();
+  }
+
+  void SetOrder(uint8_t o) {
+    order = ArpOrder(o < ARP_ORDER_COUNT ? o : uint8_t(ARP_UP));
+    Restart();
+  }
+  void SetOctaves(uint8_t n) {
+    octaves = n < 1 ? 1 : n > MAX_OCTAVES ? MAX_OCTAVES : n;
+    if (pos_ >= span()) pos_ = 0;
+  }
+  void Restart() {
+    down_ = (order == ARP_DOWN);
+    pos_ = (down_ && count_) ? span() - 1 : 0;
+    fresh_ = true;
+  }
+
+  // semitone for the next step, or NO_NOTE with no keys held
+  uint8_t Next(uint8_t rand) {
+    const uint8_t n = span();
+    if (!n) return NO_NOTE;
+    if (!fresh_) {
+      switch (order) {
+        case ARP_DOWN:
+          pos_ = pos_ ? pos_ - 1 : n - 1;
+          break;
+        case ARP_UPDOWN:
+          if (n == 1) break;
+          if (down_ ? pos_ == 0 : pos_ + 1 >= n) down_ = !down_;
+          pos_ = down_ ? pos_ - 1 : pos_ + 1;
+          break;
+        case ARP_RANDOM:
+          pos_ = (uint16_t(rand) * n) >> 8;
+          break;
+        default: // up, as played
+          if (++pos_ >= n) pos_ = 0;
+          break;
+      }
+    }
+    fresh_ = false;
+    const uint8_t oct = pos_ / count_;
+    const uint8_t idx = pos_ - oct * count_;
+    return (order == ARP_PLAYED ? played_[idx] : sorted_[idx]) + 12 * oct;
+  }
+
+  bool Remove(uint8_t *notes, uint8_t semi) {
+    uint8_t i = 0;
+    while (i < count_ && notes[i] != semi) ++i;
+    if (i == count_) return false;
+    for (; i + 1 < count_; ++i) notes[i] = notes[i + 1];
+    return true;
+  }
+};
@@ -0,0 +1,138 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+//
+// Board definition: Teensy++ 2.0 fitted in the TB-303 CPU socket
+//
+
+#pragma once
+#include "../hal.h"
+#include "../progmem.h"
+
+// pinout with Teensy++ 2.0 fitted
+// - enum symbol names correspond to the TB-303 CPU pins
+// - comments indicate Teensy Port designations
+enum TppPinout : uint8_t {
+  MIDI_IN_PIN = 2, // PD2
+  MIDI_OUT_PIN = 3, // PD3
+
+  // Port C - Data inputs/outputs...?
+  PC0_PIN = 4, // PD4 - Time Mode LED
+  PC1_PIN = 5, // PD5 - A# key LED
+  PC2_PIN = 6, // PD6 - Pitch Mode LED
+  PC3_PIN = 7, // PD7 - Function LED
+
+  // PI1 is Clock for the CV Out flip-flop, and also enables Slide while held
+  PI1_PIN = 8, // Pitch data latch strobe - PE0
+  PI2_PIN = 9, // Gate signal - PE1
+
+  // Ports D & F - memory address to pitch data - CV out
+  PD0_PIN = 10, // bit 0 - PC0
+  PD1_PIN = 11, // bit 1 - PC1
+  PD2_PIN = 12, // bit 2 - PC2
+  PD3_PIN = 13, // bit 3 - PC3
+  PF0_PIN = 14, // bit 4 - PC4
+  PF1_PIN = 15, // bit 5 - PC5
+  PF2_PIN = 16, // memory (unused) - PC6
+  PF3_PIN = 17, // memory (unused) - PC7
+
+  // Port E - memory address (probably unused)
+  PE3_PIN = 1, // PD1
+  PE2_PIN = 0, // PD0
+  PE1_PIN = 19, // PE7
+  PE0_PIN = 18, // used for Accent - PE6
+
+  // Port B - Switch board INPUTS (buttons)
+  PB3_PIN = 27, // PB7
+  PB2_PIN = 26, // PB6
+  PB1_PIN = 25, // PB5
+  PB0_PIN = 24, // PB4
+
+  // Port A - switched inputs to STATUS (TEMPO CLOCK, START/STOP, TAP)
+  PA3_PIN = 23, // PB3
+  PA2_PIN = 22, // PB2
+  PA1_PIN = 21, // PB1
+  PA0_PIN = 20, // PB0
+
+  // Port H - switched outputs to STATUS, BUFFER, & GATE
+  // These are the mux selectors for PG, PA, and PB
+  PH0_PIN = 38, // PF0
+  PH1_PIN = 39, // PF1
+  PH2_PIN = 40, // PF2
+  PH3_PIN = 41, // PF3
+
+  // Port G - drive signals to switch board LEDs
+  PG0_PIN = 42, // [1], [DEL], [DOWN], [5] - PF4
+  PG1_PIN = 43, // [2], [INS], [UP], [6] - PF5
+  PG2_PIN = 44, // [3], [F#], [ACCENT], [7] - PF6
+  PG3_PIN = 45, // [4], [G#], [SLIDE], [8] - PF7
+};
+
+// constant tables live in flash - see progmem.h
+const FlashArray<uint8_t, 8> INPUTS PROGMEM = {{
+  // Teensy Port B
+  PA0_PIN, PA1_PIN, PA2_PIN, PA3_PIN,
+  PB0_PIN, PB1_PIN, PB2_PIN, PB3_PIN,
+}};
+const FlashArray<uint8_t, 26> OUTPUTS PROGMEM = {{
+  // Teensy Port D
+  PC0_PIN, PC1_PIN, PC2_PIN, PC3_PIN,
+  PE2_PIN, PE3_PIN,
+
+  // Teensy Port E
+  PE0_PIN, PE1_PIN,
+  PI1_PIN, PI2_PIN,
+
+  // Teensy Port C
+  PD0_PIN, PD1_PIN, PD2_PIN, PD3_PIN,
+  PF0_PIN, PF1_PIN, PF2_PIN, PF3_PIN,
+  // Teensy Port F
+  PG0_PIN, PG1_PIN, PG2_PIN, PG3_PIN,
+  PH0_PIN, PH1_PIN, PH2_PIN, PH3_PIN,
+
+}};
+
+// the same signals, resolved to port and bit at compile time
+namespace Board {
+  typedef IoPin<PORT_F, 0> PH0;
+  typedef IoPin<PORT_F, 1> PH1;
+  typedef IoPin<PORT_F, 2> PH2;
+  typedef IoPin<PORT_F, 3> PH3;
+  typedef IoPin<PORT_F, 4> PG0;
+  typedef IoPin<PORT_F, 5> PG1;
+  typedef IoPin<PORT_F, 6> PG2;
+  typedef IoPin<PORT_F, 7> PG3;
+
+  typedef IoPin<PORT_B, 0> PA0;
+  typedef IoPin<PORT_B, 1> PA1;
+  typedef IoPin<PORT_B, 2> PA2;
+  typedef IoPin<PORT_B, 3> PA3;
+  typedef IoPin<PORT_B, 4> PB0;
+  typedef IoPin<PORT_B, 5> PB1;
+  typedef IoPin<PORT_B, 6> PB2;
+  typedef IoPin<PORT_B, 7> PB3;
+
+  typedef IoPin<PORT_D, 4> PC0;
+  typedef IoPin<PORT_D, 5> PC1;
+  typedef IoPin<PORT_D, 6> PC2;
+  typedef IoPin<PORT_D, 7> PC3;
+
+  typedef IoPin<PORT_E, 0> PI1; // latch strobe / slide
+  typedef IoPin<PORT_E, 1> PI2; // gate
+  typedef IoPin<PORT_E, 6> PE0; // accent
+
+  typedef PinGroup<PH0, PH1, PH2, PH3> SelectPins;
+  typedef PinGroup<PG0, PG1, PG2, PG3> LedPins;
+  typedef PinGroup<PB0, PB1, PB2, PB3> ButtonPins;
+  typedef PinGroup<PA0, PA1, PA2, PA3> StatusPins;
+  typedef PinGroup<PC0, PC1, PC2, PC3> DirectLedPins;
+
+  // 6-bit pitch on the low bits, gate/accent/slide on the control port
+  typedef IoPort<PORT_C> CvPort;
+  typedef IoPort<PORT_E> CtrlPort;
+
+  // all selects high, all switched LEDs off - PH and PG share PORTF here
+  inline void Deselect() { IoPort<PORT_F>::port() = 0x0f; }
+  inline bool RowSelected() { return (IoPort<PORT_F>::port() & 0x0f) != 0x0f; }
+  // whatever row and LEDs are up, to put back after a look at the status lines
+  inline uint8_t Selection() { return IoPort<PORT_F>::port(); }
+  inline void Reselect(uint8_t s) { IoPort<PORT_F>::port() = s; }
+} // namespace Board
@@ -0,0 +1,155 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Input clock ratio - run half-time or double-time against the sync source
+ *
+ * Division passes every nth source tick, counted from Start, so it can't
+ * slip. Multiplication passes each source tick straight through and fills
+ * the gap to the next one with ticks from Timer1, spaced by the last
+ * measured source period. Any that haven't fired by the next source tick
+ * go out with it, so every source tick is worth exactly mul engine ticks
+ * and the engine stays locked to the source however the tempo moves.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "progmem.h"
+#include "flightlog.h"
+
+enum ClockRatio : uint8_t {
+  RATIO_1_1,
+  RATIO_MUL2,
+  RATIO_MUL3,
+  RATIO_MUL4,
+  RATIO_DIV2,
+  RATIO_DIV3,
+  RATIO_DIV4,
+
+  RATIO_COUNT
+};
+struct RatioDef {
+  uint8_t mul, div;
+};
+const FlashArray<RatioDef, RATIO_COUNT> clock_ratios PROGMEM = {{
+  {1, 1}, {2, 1}, {3, 1}, {4, 1}, {1, 2}, {1, 3}, {1, 4},
+}};
+
+namespace ClockScaler {
+  static constexpr uint32_t MIN_PERIOD_US = 1000;   // faster than 2500bpm isn't either
+  static constexpr uint32_t MAX_PERIOD_US = 250000; // slower than 10bpm isn't a clock
+  static constexpr uint8_t US_PER_COUNT = 4; // Timer1 at clk/64
+
+  static ClockRatio ratio_ = RATIO_1_1;
+  static uint8_t mul_ = 1, div_ = 1;
+  static uint8_t phase_ = 0;          // source ticks since the last divided tick
+  static uint32_t last_us_ = 0;
+  static uint32_t period_us_ = 20833; // source tick, 120bpm until measured
+  static bool measured_ = false;      // a source tick has been seen
+
+  // timer side
+  static volatile uint8_t pending_ = 0; // interpolated ticks for the loop
+  static volatile uint8_t left_ = 0;    // interpolated ticks still scheduled
+  static uint16_t interval_ = 0;        // timer counts between them
+
+  inline void Init() {
+    TCCR1A = 0;
+    TCCR1B = (1 << CS11) | (1 << CS10); // free-running, clk/64 - 4us per count
+  }
+
+  inline void Cancel() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      TIMSK1 &= ~(1 << OCIE1A);
+      left_ = 0;
+      pending_ = 0;
+    }
+  }
+  // line up with the top of the song
+  inline void Reset() {
+    Cancel();
+    phase_ = 0;
+  }
+
+  inline void SetRatio(uint8_t r) {
+    ratio_ = ClockRatio(r < RATIO_COUNT ? r : uint8_t(RATIO_1_1));
+    Recorder::Log(REC_RATIO, ratio_);
+    const RatioDef def = clock_ratios[ratio_];
+    mul_ = def.mul;
+    div_ = def.div;
+    Cancel();
+    phase_ = 0;
+  }
+  inline ClockRatio ratio() { return ratio_; }
+
+  // engine tick length, for ratchets and record quantizing
+  inline uint32_t tick_us() { return period_us_ * div_ / mul_; }
+
+  // the source ticks read this pass - returns the engine ticks to run now.
+  // Ticks that arrive together (a burst of MIDI Clocks in one read) share a
+  // timestamp, so the period is measured once per pass: the time since the
+  // last pass over the ticks it brought.
+  inline uint8_t Edge(uint8_t n) {
+    if (!n) return 0;
+    const uint32_t now = micros();
+    const uint32_t period = (now - last_us_) / n;
+    const bool valid = measured_ && period >= MIN_PERIOD_US && period < MAX_PERIOD_US;
+    if (valid) period_us_ = period;
+    last_us_ = now;
+    measured_ = true;
+
+    if (div_ > 1) {
+      uint8_t pass = 0;
+      for (uint8_t i = 0; i < n; ++i) {
+        pass += (phase_ == 0);
+        if (++phase_ >= div_) phase_ = 0;
+      }
+      return pass;
+    }
+    if (mul_ == 1) return n;
+
+    // all but the last source tick are already behind us - their fills go out now
+    uint8_t ticks = 1 + (n - 1) * mul_;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      TIMSK1 &= ~(1 << OCIE1A);
+      ticks += left_; // late - the source sped up
+      left_ = 0;
+    }
+    interval_ = period_us_ / (US_PER_COUNT * mul_);
+    if (!valid || interval_ < 2) {
+      // no period to spread them over yet - keep the count, lose the spacing
+      return ticks + mul_ - 1;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      OCR1A = TCNT1 + interval_;
+      TIFR1 = (1 << OCF1A);
+      left_ = mul_ - 1;
+      TIMSK1 |= (1 << OCIE1A);
+    }
+    return ticks;
+  }
+
+  // interpolated ticks the timer has placed since the last call
+  inline uint8_t Take() {
+    uint8_t n;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      n = pending_;
+      pending_ = 0;
+    }
+    return n;
+  }
+
+  // Song Position: the source tick to jump to -> the engine tick that plays
+  // at the next source tick that passes
+  inline uint32_t Locate(uint32_t source_tick) {
+    Cancel();
+    phase_ = source_tick % div_;
+    return (source_tick * mul_ + div_ - 1) / div_;
+  }
+} // namespace ClockScaler
+
+ISR(TIMER1_COMPA_vect) {
+  ++ClockScaler::pending_;
+  if (--ClockScaler::left_)
+    OCR1A += ClockScaler::interval_;
+  else
+    TIMSK1 &= ~(1 << OCIE1A);
+}
@@ -1,64 +1,249 @@
 // Copyright (c) 2026, Nicholas J. Michalek
 
 #pragma once
+#include <util/atomic.h>
 #include "pins.h"
+#include "ring.h"
 
 static constexpr uint16_t SWITCH_DELAY = 15; // microseconds
+static constexpr uint16_t SCAN_SETTLE = 2;   // microseconds, per select row
 
 //
 // --- 303 CPU driver functions
 //
 
 namespace DAC {
-  static uint8_t pitch_ = 0;
-  static uint8_t octave_bits_ = 0;
-  static uint8_t slide_ = false;
-  static uint8_t accent_ = false;
-  static uint8_t gate_ = false;
+  // control port bits
+  static constexpr uint8_t SLIDE_BIT = Board::PI1::mask;  // latch strobe, held for slide
+  static constexpr uint8_t GATE_BIT = Board::PI2::mask;
+  static constexpr uint8_t ACCENT_BIT = Board::PE0::mask;
 
-  inline void Send() {
+  static uint8_t cv_ = 0;   // CvPort - 4-bit pitch with 2-bit octave
+  static uint8_t ctrl_ = 0; // CtrlPort - gate, accent, slide
+
+  // last state committed to the ports
+  static uint8_t sent_cv_ = 0xff;
+  static uint8_t sent_ctrl_ = 0xff;
+  static uint16_t commits_ = 0;
+  static uint16_t commit_rate_ = 0; // commits per second
+
+  // gate edges left for Timer3 to place - the ISR owns the gate bit while nonzero
+  static volatile uint8_t retrig_edges_ = 0;
+
+  // only touches the ports when something changed - returns true if it did
+  inline bool Send() {
     // send to gate pin
     //digitalWriteFast(PI2_PIN, gate_ ? HIGH : LOW);
     // send to accent pin
     //digitalWriteFast(PE0_PIN, accent_ ? HIGH : LOW);
 
-    // set 6-bit pitch for CV Out
-    PORTC = pitch_ | (octave_bits_ << 4); // & 0x3f;
+    if (cv_ == sent_cv_ && ctrl_ == sent_ctrl_) return false;
+    volatile uint8_t &CTRL = Board::CtrlPort::port();
 
-    PORTE = 0; // disable latch
-    // set gate and accent pins, enable latch/slide
-    PORTE = (gate_ << 1) | (accent_ << 6) | 0x1;
+    // pitch and accent are clocked into the flip-flop by a rising PI1 edge
+    if (cv_ != sent_cv_ || ((ctrl_ ^ sent_ctrl_) & ACCENT_BIT)) {
+      // set 6-bit pitch for CV Out before the strobe, so the latch only sees the final value
+      Board::CvPort::port() = cv_; // & 0x3f;
 
-    if (!slide_) // turn slide bit back off
-      PORTE ^= 0x1;
+      // gate stays where it was while the latch is strobed
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        const uint8_t hold = (CTRL & GATE_BIT) | (ctrl_ & ACCENT_BIT);
+        CTRL = hold; // latch low
+        CTRL = hold | SLIDE_BIT; // rising edge
+      }
+    }
+    // final gate level, and slide keeps the strobe raised
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (retrig_edges_)
+        CTRL = (ctrl_ & ~GATE_BIT) | (CTRL & GATE_BIT);
+      else
+        CTRL = ctrl_;
+    }
+
+    sent_cv_ = cv_;
+    sent_ctrl_ = ctrl_;
+    ++commits_;
+    return true;
+  }
 
-    // toggle the latch/slide pin
-    //PORTE ^= 1;
-    //PORTE ^= 1;
-    // ...but this other way is... smarter? dumber? better.
-    // Clock for the D/A converter chip
-    /*
-    if (slide) digitalWriteFast(PI1_PIN, LOW);
-    digitalWriteFast(PI1_PIN, HIGH);
-    if (!slide) digitalWriteFast(PI1_PIN, LOW);
-    */
+  // Retrigger the gate count-1 more times inside one step, placed by Timer3.
+  // Each retrigger gets an even share of the step, gate high for the first half.
+  // With hold, the last gate stays open for a slide or tie.
+  inline void CancelRatchet() {
+    TCCR3B = 0;
+    retrig_edges_ = 0;
   }
+  inline void Ratchet(uint8_t count, uint32_t step_us, bool hold) {
+    CancelRatchet();
+    if (count < 2) return;
 
+    const uint32_t half = step_us / (count * 2) / 4; // 4us per timer count
+    if (half == 0 || half > 0xffff) return;
+
+    retrig_edges_ = count * 2 - (hold ? 2 : 1);
+    TCCR3A = 0;
+    TCNT3 = 0;
+    OCR3A = half - 1;
+    TIFR3 = (1 << OCF3A);
+    TIMSK3 = (1 << OCIE3A);
+    TCCR3B = (1 << WGM32) | (1 << CS31) | (1 << CS30); // CTC, clk/64
+  }
+  inline bool ratcheting() { return retrig_edges_; }
+
+  // call once per second
+  inline void Tally() {
+    commit_rate_ = commits_;
+    commits_ = 0;
+  }
+  inline uint16_t commit_rate() { return commit_rate_; }
+
+  // precomputed port bytes, straight from the engine's step table
+  inline void Load(uint8_t cv, uint8_t ctrl) {
+    cv_ = cv;
+    ctrl_ = ctrl;
+  }
   inline void SetPitch(uint8_t p, uint8_t oct = 0) {
-    pitch_ = p;
-    octave_bits_ = oct;
+    cv_ = p | (oct << 4);
   }
   inline void SetGate(bool on) {
-    gate_ = on;
+    ctrl_ = (ctrl_ & ~GATE_BIT) | (on ? GATE_BIT : 0);
   }
   inline void SetAccent(bool on) {
-    accent_ = on;
+    ctrl_ = (ctrl_ & ~ACCENT_BIT) | (on ? ACCENT_BIT : 0);
   }
   inline void SetSlide(bool on) {
-    slide_ = on;
+    ctrl_ = (ctrl_ & ~SLIDE_BIT) | (on ? SLIDE_BIT : 0);
   }
 } // namespace DAC
 
+ISR(TIMER3_COMPA_vect) {
+  Board::CtrlPort::port() ^= DAC::GATE_BIT;
+  if (--DAC::retrig_edges_ == 0) TCCR3B = 0;
+}
+
+// DIN sync -> MIDI bridge
+// RUN and CLOCK share their status lines with the switch matrix, so they
+// only show while it's deselected - an edge that comes while an LED row is
+// lit isn't on the pin at all. So Timer1 compare C looks every PERIOD: it
+// blanks the lit row, comes back SETTLE later to read the lines, and puts
+// the row back - two short interrupts, no waiting inside either. It leaves
+// the matrix alone while PollInputs scans (which samples as it finishes),
+// and skips a look the loop changed the LEDs in the middle of.
+//
+// The bytes go straight into the UART from the same interrupt when its
+// data register is free - realtime bytes may go between the bytes of any
+// other message. When HardwareSerial has a byte waiting there, its data
+// register interrupt is held off until the next look, one byte time later,
+// and the realtime byte takes the slot - unless a write from the loop arms
+// it again first, which costs another byte time.
+//
+// Edge to start bit: up to PERIOD to be seen, then up to one byte time for
+// the byte already on the wire - 0.64ms at worst, about 0.2ms on average
+// with the UART idle. A byte waiting in the data register adds one PERIOD,
+// and Start goes one byte ahead of the Clock that comes with it. A pulse
+// has to last PERIOD plus a scan (~0.4ms) to be sure of being seen.
+namespace DinSync {
+  typedef Board::StatusPins::At<0>::Pin RunPin;
+  typedef Board::StatusPins::At<3>::Pin ClockPin;
+
+  static constexpr uint8_t RUN_LINE = 1;
+  static constexpr uint8_t CLOCK_LINE = 2;
+
+  // Timer1 counts, 4us each - see clock.h
+  static constexpr uint16_t PERIOD = 80; // 320us, one MIDI byte on the wire
+  static constexpr uint16_t SETTLE = (SWITCH_DELAY + 3) / 4; // lines settle after a deselect
+
+  static volatile bool scanning_ = false; // PollInputs owns the matrix
+  static volatile bool enabled_ = false;  // forwarding on
+  static uint8_t last_ = 0;               // RUN_LINE | CLOCK_LINE
+  static RingBuffer<uint8_t, 8> out_;     // realtime bytes for the UART
+  static bool looking_ = false; // the matrix is blanked for a read
+  static uint8_t lit_ = 0;      // the selection it put aside
+  static volatile bool moved_ = false; // the loop changed it since
+
+  inline uint8_t Lines() {
+    return (RunPin::Read() ? RUN_LINE : 0) | (ClockPin::Read() ? CLOCK_LINE : 0);
+  }
+  // compare the lines against the last sample and queue new edges
+  inline void Sample(uint8_t now) {
+    const uint8_t rose = now & ~last_;
+    const uint8_t fell = last_ & ~now;
+    last_ = now;
+    if (!enabled_) return;
+
+    if (rose & RUN_LINE) out_.Push(0xfa); // Start, ahead of its first clock
+    if (rose & CLOCK_LINE) out_.Push(0xf8); // Clock
+    if (fell & RUN_LINE) out_.Push(0xfc); // Stop
+  }
+
+  // one realtime byte into the UART, interrupts off. HardwareSerial only
+  // writes the data register from its own interrupt, when it's empty.
+  inline void Send() {
+    if (out_.empty()) return;
+    if (UCSR1A & (1 << UDRE1)) {
+      uint8_t b;
+      out_.Pop(b);
+      UDR1 = b;
+      UCSR1B |= (1 << UDRIE1); // its interrupt turns itself off if it has nothing
+    } else {
+      UCSR1B &= ~(1 << UDRIE1); // the next free slot is ours
+    }
+  }
+
+  // Timer1 compare C
+  inline void Tick() {
+    if (!looking_) {
+      if (scanning_) { // Release() samples
+        Send();
+        OCR1C += PERIOD;
+        return;
+      }
+      lit_ = Board::Selection();
+      Board::Deselect();
+      moved_ = false;
+      looking_ = true;
+      OCR1C += SETTLE;
+      return;
+    }
+    looking_ = false;
+    // a scan or the LEDs got in between - nothing to read or put back
+    if (!scanning_ && !moved_ && !Board::RowSelected()) {
+      Sample(Lines());
+      Board::Reselect(lit_);
+    }
+    Send();
+    OCR1C += PERIOD - SETTLE;
+  }
+
+  // the LEDs are about to change the matrix - see Tick()
+  inline void Moved() { moved_ = true; }
+
+  // PollInputs brackets its scan with these
+  inline void Hold() { scanning_ = true; }
+  inline void Release() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      Sample(Lines());
+      Send();
+      scanning_ = false;
+    }
+  }
+
+  // only forward while DIN sync is the clock source
+  inline void Enable(bool on) { enabled_ = on; }
+
+  inline void Init() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      OCR1C = TCNT1 + PERIOD;
+      TIFR1 = (1 << OCF1C);
+      TIMSK1 |= (1 << OCIE1C);
+    }
+  }
+} // namespace DinSync
+
+ISR(TIMER1_COMPC_vect) {
+  DinSync::Tick();
+}
+
 namespace Leds {
   // like a framebuffer, each bit corresponds to an entry in the switched_leds table
   static uint8_t ledstate[3];
@@ -69,25 +254,22 @@ namespace Leds {
     ledstate[row] = (ledstate[row] & ~(1 << bit_idx)) | (enable << bit_idx);
   }
   void Set(const MatrixPin pins, bool enable = true) {
+    DinSync::Moved();
     if (enable && pins.select) {
-      PORTF = 0x0f;
+      Board::Deselect();
       digitalWriteFast(pins.select, LOW);
     }
     digitalWriteFast(pins.led, enable ? HIGH : LOW);
     //if (enable && pins.select) digitalWriteFast(pins.select, HIGH);
   }
 
-  void SetLedSelection(uint8_t select_pin, uint8_t enable_mask) {
-    const uint8_t switched_pins[4] = {
-      PG0_PIN, PG1_PIN, PG2_PIN, PG3_PIN,
-    };
-
-    PORTF = 0x0f;
+  template <uint8_t ROW>
+  inline void SetLedSelection(uint8_t enable_mask) {
+    DinSync::Moved();
+    Board::Deselect();
     delayMicroseconds(SWITCH_DELAY);
-    digitalWriteFast(select_pin, LOW);
-    for (uint8_t i = 0; i < 4; ++i) {
-      digitalWriteFast(switched_pins[i], (enable_mask & (1 << i))?HIGH:LOW);
-    }
+    Board::SelectPins::At<ROW>::Pin::Low();
+    Board::LedPins::Write(enable_mask);
   }
 
   void Send(const uint8_t tick, const bool clear = true) {
@@ -96,12 +278,15 @@ namespace Leds {
     // switched LEDs
     // which row depends on tick
     uint8_t mask = ledstate[(tick >> 1) & 1] >> (4 * ((tick >> 0) & 1));
-    SetLedSelection(switched_leds[(tick & 0x3) << 2].select, mask);
+    switch (tick & 0x3) {
+      case 0: SetLedSelection<0>(mask); break;
+      case 1: SetLedSelection<1>(mask); break;
+      case 2: SetLedSelection<2>(mask); break;
+      case 3: SetLedSelection<3>(mask); break;
+    }
 
     // direct LEDs
-    for (uint8_t i = 16; i < 20; ++i) {
-      digitalWriteFast(switched_leds[i].led, (ledstate[2] & (1 << (i-16))) ? HIGH : LOW);
-    }
+    Board::DirectLedPins::Write(ledstate[2]);
 
     if (clear) {
       // blank slate for next time
@@ -113,48 +298,70 @@ namespace Leds {
 
 } // namespace Leds
 
-void PollInputs(PinState *inputs) {
-  //PORTF = 0x00;
-  PORTF = 0x0f;
+// compact timestamp - 16us per count, wraps after ~1s
+typedef uint16_t Stamp;
+inline Stamp StampNow() { return micros() >> 4; }
+
+// open one switched channel with its select pin, read buttons and status together
+template <uint8_t ROW>
+inline void ScanRow(PinState *inputs) {
+  typedef typename Board::SelectPins::template At<ROW>::Pin Select;
+  Select::Low(); // PHx
+  // let the row's lines swing through the matrix and the pin synchronizer
+  // before sampling - a read straight after the select sees the last row
+  delayMicroseconds(SCAN_SETTLE);
+  const uint8_t buttons = Board::ButtonPins::Read(); // PBx
+  const uint8_t status = Board::StatusPins::Read(); // PAx
+  Select::High(); // PHx
+  for (uint8_t j = 0; j < 4; ++j) {
+    inputs[ 0 + ROW*4 + j].push(buttons >> j & 1);
+    inputs[16 + ROW*4 + j].push(status >> j & 1);
+  }
+}
+
+// returns when the matrix was sampled
+Stamp PollInputs(PinState *inputs) {
+  DinSync::Hold();
+  Board::Deselect();
   delayMicroseconds(SWITCH_DELAY);
-  //PORTF = 0xff;
-
-  /*
-  digitalWriteFast(select_pin[0], HIGH);
-  digitalWriteFast(select_pin[1], HIGH);
-  digitalWriteFast(select_pin[2], HIGH);
-  digitalWriteFast(select_pin[3], HIGH);
-  // all LEDs
-  digitalWriteFast(PG0_PIN, HIGH);
-  digitalWriteFast(PG1_PIN, HIGH);
-  digitalWriteFast(PG2_PIN, HIGH);
-  digitalWriteFast(PG3_PIN, HIGH);
-  */
-
-  // read PA and PB pins while select pins are high
+
+  // read PA pins while select pins are high
+  const uint8_t status = Board::StatusPins::Read();
   for (uint8_t i = 0; i < 4; ++i) {
-    inputs[EXTRA_PIN_OFFSET + i].push(digitalReadFast(status_pins[i])); // PAx
+    inputs[EXTRA_PIN_OFFSET + i].push(status >> i & 1); // PAx
     // not sure if these are actually used...
-    //inputs[EXTRA_PIN_OFFSET + i+4].push(digitalReadFast(button_pins[i])); // PBx
+    //inputs[EXTRA_PIN_OFFSET + i+4].push(Board::ButtonPins::Read() >> i & 1); // PBx
   }
 
-  //PORTF = 0x0f;
+  const Stamp stamp = StampNow(); // the rows follow within ~10us
+  ScanRow<0>(inputs);
+  ScanRow<1>(inputs);
+  ScanRow<2>(inputs);
+  ScanRow<3>(inputs);
 
-  /*
-  digitalWriteFast(PG0_PIN, LOW);
-  digitalWriteFast(PG1_PIN, LOW);
-  digitalWriteFast(PG2_PIN, LOW);
-  digitalWriteFast(PG3_PIN, LOW);
-  */
+  // everything deselected again - status lines are valid until the next LED row
+  delayMicroseconds(SWITCH_DELAY);
+  DinSync::Release();
+  return stamp;
+}
 
-  // open each switched channel with select pin
-  for (uint8_t i = 0; i < 4; ++i) {
-    digitalWriteFast(select_pin[i], LOW); // PHx
-    for (uint8_t j = 0; j < 4; ++j) {
-      // read pins
-      inputs[ 0 + i*4 + j].push(digitalReadFast(button_pins[j])); // PBx
-      inputs[16 + i*4 + j].push(digitalReadFast(status_pins[j])); // PAx
+// debounced key edge with the time of the scan that saw it
+struct InputEvent {
+  uint8_t input; // InputIndex
+  bool rising;
+  Stamp stamp;
+};
+
+// queue edges from the switch matrix after a poll - returns how many went in
+template <uint8_t SIZE>
+uint8_t QueueEdges(const PinState *inputs, RingBuffer<InputEvent, SIZE> &queue, Stamp now) {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < EXTRA_PIN_OFFSET; ++i) {
+    const uint8_t edge = inputs[i].state & STATE_ON;
+    if (edge == STATE_RISING || edge == STATE_FALLING) {
+      InputEvent ev = { i, edge == STATE_RISING, now };
+      n += queue.Push(ev);
     }
-    digitalWriteFast(select_pin[i], HIGH); // PHx
   }
+  return n;
 }
@@ -6,6 +6,12 @@
 #pragma once
 #include <Arduino.h>
 #include <EEPROM.h>
+#include "drivers.h"
+#include "telemetry.h"
+#include "presets.h"
+#include "arp.h"
+#include "history.h"
+#include "flightlog.h"
 
 //
 // *** Utilities ***
@@ -16,12 +22,109 @@
 static constexpr int MAX_STEPS = 32;
 static constexpr int NUM_PATTERNS = 16;
 
+// xorshift16 - full period, a handful of shifts on an 8-bit core
+struct Xorshift {
+  uint16_t state = 0xace1;
+
+  void Seed(uint16_t s) { state = s ? s : 0xace1; }
+  uint16_t Next() {
+    state ^= state << 7;
+    state ^= state >> 9;
+    state ^= state << 8;
+    return state;
+  }
+  // 0 <= result < n, multiply instead of modulo
+  uint8_t Below(uint8_t n) { return (uint8_t(Next()) * n) >> 8; }
+  // true with probability p/256
+  bool Chance(uint8_t p) { return uint8_t(Next() >> 8) < p; }
+};
+
+// note sets for the generator, bit 0 = C
+enum ScaleIndex : uint8_t {
+  SCALE_CHROMATIC,
+  SCALE_MAJOR,
+  SCALE_MINOR,
+  SCALE_PHRYGIAN,
+  SCALE_MINOR_PENTA,
+  SCALE_OCTAVES,
+
+  SCALE_COUNT
+};
+const FlashArray<uint16_t, SCALE_COUNT> scale_masks PROGMEM = {{
+  0x0fff, // chromatic
+  0x0ab5, // major
+  0x05ad, // natural minor
+  0x05ab, // phrygian
+  0x04a9, // minor pentatonic
+  0x0001, // root only, octaves do the work
+}};
+
+struct GenParams {
+  uint16_t seed = 303;
+  uint8_t scale = SCALE_MINOR;
+  uint8_t density = 192; // chance of a note vs. rest, out of 256
+  uint8_t tie = 32;      // chance a note becomes a tie
+  uint8_t accent = 64;
+  uint8_t slide = 48;
+  uint8_t oct_low = 1;    // OctaveState
+  uint8_t oct_range = 1; // additional octaves above oct_low
+};
+
 enum SequencerMode {
   NORMAL_MODE,
   PITCH_MODE,
   TIME_MODE,
 };
 
+// time nibble values
+enum TimeValue : uint8_t {
+  TIME_REST,
+  TIME_NOTE,
+  TIME_TIE,
+  TIME_TRIPLET, // note lasting 2/3 of a step
+};
+
+// trigger conditions, 3 bits per time step - 0 plays every time
+enum StepCondition : uint8_t {
+  COND_ALWAYS,
+  COND_75,      // chance, out of 100
+  COND_50,
+  COND_25,
+  COND_12,
+  COND_FIRST,   // first pass through the pattern only
+  COND_EVERY_2, // 2nd, 4th, 6th... pass
+  COND_EVERY_4, // 4th, 8th... pass
+
+  COND_COUNT
+};
+
+// step resolution, per pattern
+enum StepResolution : uint8_t {
+  RES_SIXTEENTH,
+  RES_SIXTEENTH_TRIPLET,
+  RES_THIRTYSECOND,
+  RES_EIGHTH,
+
+  RES_COUNT
+};
+// clock ticks @ 24ppqn for a whole step, the gate, and the accent
+struct StepTiming {
+  uint8_t step, gate, accent;
+};
+// indexed by resolution * 2 + triplet
+// Steps are whole ticks, so the grid isn't kept for you: a triplet step is
+// 2/3 of a straight one, and every step after it sits off the bar grid until
+// two more complete the group. On 1/16T there's no whole-tick 2/3 at all -
+// a group of three triplets runs 9 ticks against the 8 of two steps, so
+// each group pushes the rest of the pattern a tick later.
+const FlashArray<StepTiming, RES_COUNT * 2> step_timing PROGMEM = {{
+  // straight   triplet step
+  { 6, 3, 2}, { 4, 2, 1}, // 1/16
+  { 4, 2, 1}, { 3, 2, 1}, // 1/16T - triplet step rounds 8/3 to 3
+  { 3, 2, 1}, { 2, 1, 1}, // 1/32
+  {12, 6, 4}, { 8, 4, 3}, // 1/8
+}};
+
 enum OctaveState {
   OCTAVE_DOWN,
   OCTAVE_ZERO,
@@ -29,18 +132,81 @@ enum OctaveState {
   OCTAVE_DOUBLE_UP,
 };
 
+// shift a 6-bit pitch (4-bit note, 2-bit octave) by semitones
+static inline uint8_t TransposePitch(uint8_t p, int8_t semitones) {
+  if (!semitones) return p;
+  int n = (p & 0x0f) + 12 * (p >> 4 & 0x3) + semitones;
+  CONSTRAIN(n, 0, 48);
+  if (n == 48) return 0x3c; // top C
+  return uint8_t(n % 12) | uint8_t(n / 12) << 4;
+}
+
+// precompiled hardware output for one time step
+enum StepFlags : uint8_t {
+  STEP_GATE = 0x01, // note or tie
+  STEP_TIED = 0x02, // next step is a tie, hold accent
+  STEP_HOLD = 0x04, // slide or tie, gate stays open for the whole step
+  STEP_TRIPLET = 0x08,
+  STEP_RATCHET = 0x30, // 2-bit retrigger count - 1
+};
+static constexpr uint8_t STEP_RATCHET_SHIFT = 4;
+struct StepOutput {
+  uint8_t cv;    // PORTC byte
+  uint8_t ctrl;  // PORTE bits while the gate is open
+  uint8_t flags; // StepFlags - gate length class
+  uint8_t pitch_pos; // pitch index Advance() reaches at this step
+  uint8_t cond; // StepCondition for the note
+  uint16_t start; // clock ticks from the top of the pattern
+};
+
+// Resolve every time step to its final port bytes, following the same
+// pitch_pos walk as Sequence::Advance(). Src is anything with the Sequence
+// read accessors - a pattern in SRAM, or one read in place from flash.
+// Returns the clock ticks in one pass of the pattern.
+template <typename Src>
+uint16_t CompileSteps(const Src &src, StepOutput *table, int8_t transpose) {
+  const uint8_t len = src.steps();
+  uint8_t p = 0;
+  uint16_t ticks = 0;
+  for (uint8_t t = 0; t < len; ++t) {
+    const uint8_t tm = src.time(t);
+    if (t > 0 && (tm & TIME_NOTE)) ++p;
+
+    const uint8_t data = src.pitch_at(p);
+    const bool tied = src.time(t + 1 >= len ? 0 : t + 1) == TIME_TIE;
+    const bool slide = data & (1<<7);
+    StepOutput &out = table[t];
+    out.cv = TransposePitch(data & 0x3f, transpose);
+    out.ctrl = DAC::GATE_BIT | (slide ? DAC::SLIDE_BIT : 0)
+             | ((data & (1<<6)) ? DAC::ACCENT_BIT : 0);
+    out.flags = (tm ? STEP_GATE : 0) | (tied ? STEP_TIED : 0)
+              | ((slide || tied) ? STEP_HOLD : 0)
+              | ((tm == TIME_TRIPLET) ? STEP_TRIPLET : 0)
+              | (src.ratchet(t) << STEP_RATCHET_SHIFT);
+    out.pitch_pos = p;
+    out.cond = src.condition(t);
+    out.start = ticks;
+    ticks += src.get_timing(tm == TIME_TRIPLET).step;
+  }
+  return ticks;
+}
+
 struct Sequence {
   // --- sequence data - 64 bytes
                                  // TODO: octave up/down flags?
   uint8_t pitch[MAX_STEPS]; // 6-bit Pitch, Accent, and Slide
-  uint8_t time_data[MAX_STEPS/2];  // 0=rest, 1=note, 2=tie, 3=triplets?
+  uint8_t time_data[MAX_STEPS/2];  // TimeValue: 0=rest, 1=note, 2=tie, 3=triplet
+                                   // upper 2 bits of each nibble: ratchet count - 1
   // time is stored as nibbles, so there's actually a lot of padding
-  uint8_t reserved[MAX_STEPS/2 - 1];
+  uint8_t resolution; // StepResolution
+  uint8_t conditions[3][MAX_STEPS/8]; // StepCondition of each time step, as 3 bit planes
+  uint8_t mod_conditions; // StepCondition for every accent (low nibble) and slide (high nibble)
+  uint8_t reserved[1];
   uint8_t length = 16;
   // --- end sequence data
 
   // state
-  int pitch_pos, time_pos;
+  uint8_t pitch_pos, time_pos;
   bool reset; // hold plz
 
   // --- functions
@@ -60,20 +226,56 @@ struct Sequence {
   const bool get_slide() const {
     return get_slide(pitch_pos);
   }
+  // the step after idx, wrapping at the end of the pattern
+  inline uint8_t next_step(uint8_t idx) const {
+    return (idx + 1 < length) ? idx + 1 : 0;
+  }
   const bool is_tied() const {
-    return (time_pos < length) && (time(time_pos+1) == 2);
+    return time(next_step(time_pos)) == TIME_TIE;
   }
   inline uint8_t time(uint8_t idx) const {
-    return (time_data[idx >> 1] >> 4*(idx & 1)) & 0xf;
+    return (time_data[idx >> 1] >> 4*(idx & 1)) & 0x3;
+  }
+  // 0-3 for 1-4 triggers in the step
+  inline uint8_t ratchet(uint8_t idx) const {
+    return (time_data[idx >> 1] >> (4*(idx & 1) + 2)) & 0x3;
   }
   const uint8_t get_time() const {
     return time(time_pos);
   }
+  inline uint8_t condition(uint8_t idx) const {
+    const uint8_t i = idx >> 3, bit = idx & 7;
+    return (conditions[0][i] >> bit & 1) | (conditions[1][i] >> bit & 1) << 1
+         | (conditions[2][i] >> bit & 1) << 2;
+  }
+  void SetConditionAt(uint8_t idx, uint8_t c) {
+    const uint8_t bit = idx & 7;
+    for (uint8_t k = 0; k < 3; ++k) {
+      uint8_t &plane = conditions[k][idx >> 3];
+      plane = (plane & ~(1 << bit)) | ((c >> k & 1) << bit);
+    }
+  }
 
   void SetTime(uint8_t t) {
-    const uint8_t upper = time_pos & 1;
-    uint8_t &data = time_data[time_pos >> 1];
-    data = (~(0x0f << 4*upper) & data) | (t << 4*upper);
+    SetTimeAt(time_pos, t);
+  }
+  void SetTimeAt(uint8_t idx, uint8_t t) {
+    const uint8_t upper = idx & 1;
+    uint8_t &data = time_data[idx >> 1];
+    data = (~(0x0f << 4*upper) & data) | ((t & 0x0f) << 4*upper);
+  }
+  // the pitch_pos that Advance() would reach at time step idx
+  uint8_t pitch_index(uint8_t idx) const {
+    uint8_t p = 0;
+    for (uint8_t t = 1; t <= idx; ++t) {
+      if (time(t) & TIME_NOTE) ++p;
+    }
+    return p;
+  }
+  void SetRatchetAt(uint8_t idx, uint8_t r) {
+    const uint8_t shift = 4*(idx & 1) + 2;
+    uint8_t &data = time_data[idx >> 1];
+    data = (~(0x03 << shift) & data) | ((r & 0x3) << shift);
   }
   void SetPitch(uint8_t p, uint8_t flags) {
     pitch[pitch_pos] = (p & 0x0f) | (flags & 0xf0);
@@ -82,7 +284,19 @@ struct Sequence {
     // 4-bit pitch value
     pitch[pitch_pos] = (p & 0x0f) | (pitch[pitch_pos] & 0xf0);
   }
-  void SetLength(uint8_t len) { length = constrain(len, 1, MAX_STEPS); }
+  void SetLength(uint8_t len) {
+    length = constrain(len, 1, MAX_STEPS);
+    // keep the playhead inside the pattern - the pitch lane restarts with the time lane
+    if (time_pos >= length) time_pos = pitch_pos = 0;
+    if (pitch_pos >= length) pitch_pos = 0;
+  }
+  bool Valid() const {
+    return length >= 1 && length <= MAX_STEPS && time_pos < length && pitch_pos < length;
+  }
+  void SetResolution(uint8_t res) { resolution = res < RES_COUNT ? res : 0; }
+  StepTiming get_timing(bool triplet) const {
+    return step_timing[(resolution & 0x3) << 1 | triplet];
+  }
   void SetOctave(int oct) {
     CONSTRAIN(oct, 0, 3);
     pitch[pitch_pos] = (uint8_t(oct & 0x3) << 4) | (pitch[pitch_pos] & 0xcf);
@@ -98,15 +312,31 @@ struct Sequence {
   }
 
   bool BumpLength() {
-    if (++length == MAX_STEPS) return false;
-    return true;
+    if (length >= MAX_STEPS) return false;
+    return ++length < MAX_STEPS;
   }
 
-  void RegenTime() {
-    time_data[time_pos] = random();
+  void RegenTime(Xorshift &rng, const GenParams &gen) {
+    uint8_t t = 0; // rest
+    if (rng.Chance(gen.density))
+      t = (time_pos > 0 && rng.Chance(gen.tie)) ? 2 : 1;
+    SetTime(t);
   }
-  void RegenPitch() {
-    pitch[pitch_pos] = random();
+  void RegenPitch(Xorshift &rng, const GenParams &gen) {
+    // pick from the scale, with top C as a 13th choice when C is in it
+    const uint16_t scale = scale_masks[gen.scale % SCALE_COUNT];
+    const uint16_t mask = scale | (scale & 1) << 12;
+    uint8_t notes[13];
+    uint8_t count = 0;
+    for (uint8_t n = 0; n < 13; ++n) {
+      if (mask & (1 << n)) notes[count++] = n;
+    }
+    uint8_t oct = gen.oct_low + rng.Below(gen.oct_range + 1);
+    if (oct > OCTAVE_DOUBLE_UP) oct = OCTAVE_DOUBLE_UP;
+    const uint8_t flags = (oct << 4)
+                        | (rng.Chance(gen.accent) << 6)
+                        | (rng.Chance(gen.slide) << 7);
+    SetPitch(notes[rng.Below(count)], flags);
   }
 
   void Reset() {
@@ -119,54 +349,218 @@ struct Sequence {
       pitch[i] = 0;
       time_data[i>>1] = 0;
     }
+    memset(conditions, 0, sizeof(conditions));
+    mod_conditions = 0;
     length = 8;
+    resolution = RES_SIXTEENTH;
+  }
+  // back to notes, time values and length only - ratchets, conditions and
+  // resolution cleared
+  void ClearStepFlags() {
+    for (uint8_t i = 0; i < MAX_STEPS/2; ++i) time_data[i] &= 0x33;
+    memset(conditions, 0, sizeof(conditions));
+    mod_conditions = 0;
+    resolution = RES_SIXTEENTH;
+    reserved[0] = 0;
   }
 
   // returns false for rests
   bool Advance() {
     if (reset) {
       reset = false;
-      return true;
+      return time(time_pos);
     }
-    ++time_pos %= length;
+    if (++time_pos >= length) time_pos = 0;
     if (time_pos == 0)
       pitch_pos = 0;
-    else if (time(time_pos) == 1)
-      ++pitch_pos;
+    else if ((time(time_pos) & TIME_NOTE) && ++pitch_pos >= length) // note or triplet
+      pitch_pos = 0; // pitch entry can leave it ahead of the time step
     return time(time_pos);
   }
 
+  // the accessors CompileSteps() reads through
+  uint8_t steps() const { return length; }
+  uint8_t pitch_at(uint8_t idx) const { return pitch[idx]; }
+
+  uint16_t Compile(StepOutput *table, int8_t transpose) const {
+    return CompileSteps(*this, table, transpose);
+  }
+
   // used in write mode
   void AdvancePitch() {
     if (reset) reset = false;
-    else ++pitch_pos %= length;
+    else if (++pitch_pos >= length) pitch_pos = 0;
+  }
+};
+
+// Bit-plane working copy of a Sequence, for whole-pattern edits - one 32-bit
+// mask per attribute, indexed by time step, so rotate and reverse are word
+// operations. Pitch and flags are resolved per time step (what you hear), so
+// the planes can be moved freely and written back with Export(). Patterns
+// stay in the Sequence layout; playback reads the compiled step table.
+struct StepPlanes {
+  uint32_t accent = 0, slide = 0;
+  uint32_t note = 0, tie = 0; // rest = neither
+  uint32_t triplet = 0; // subset of note
+  uint32_t ratchet[2] = {0, 0}; // 2-bit retrigger count, low and high planes
+  uint32_t cond[3] = {0, 0, 0}; // StepCondition, 3 planes
+  uint8_t pitch[MAX_STEPS]; // 4-bit pitch with 2-bit octave
+  uint8_t length = 16;
+
+  static uint32_t Bit(uint8_t i) { return uint32_t(1) << i; }
+  static uint32_t Span(uint8_t len) {
+    return (len >= 32) ? 0xffffffff : Bit(len) - 1;
+  }
+  static uint8_t Count(uint32_t m) { return __builtin_popcountl(m); }
+  // rotate later by n steps, inside the first len bits
+  static uint32_t Rotate(uint32_t m, uint8_t len, uint8_t n) {
+    n %= len;
+    if (!n) return m;
+    const uint32_t span = Span(len);
+    m &= span;
+    return ((m << n) | (m >> (len - n))) & span;
+  }
+  static uint32_t Reverse(uint32_t m, uint8_t len) {
+    m = ((m >> 1) & 0x55555555) | ((m & 0x55555555) << 1);
+    m = ((m >> 2) & 0x33333333) | ((m & 0x33333333) << 2);
+    m = ((m >> 4) & 0x0f0f0f0f) | ((m & 0x0f0f0f0f) << 4);
+    m = ((m >> 8) & 0x00ff00ff) | ((m & 0x00ff00ff) << 8);
+    m = (m >> 16) | (m << 16);
+    return m >> (32 - len);
+  }
+  static uint32_t Fill(uint8_t first, uint8_t last) {
+    return Span(last + 1) & ~Span(first);
+  }
+
+  // single bit queries
+  bool get_accent(uint8_t step) const { return accent & Bit(step); }
+  bool get_slide(uint8_t step) const { return slide & Bit(step); }
+  bool is_note(uint8_t step) const { return note & Bit(step); }
+  bool is_tied(uint8_t step) const { return tie & Bit((step + 1 < length) ? step + 1 : 0); }
+  bool is_rest(uint8_t step) const { return !((note | tie) & Bit(step)); }
+  uint32_t rests() const { return ~(note | tie) & Span(length); }
+
+  // whole pattern edits
+  void Rotate(uint8_t n) {
+    const uint8_t pn = n % length;
+    accent = Rotate(accent, length, n);
+    slide = Rotate(slide, length, n);
+    note = Rotate(note, length, n);
+    tie = Rotate(tie, length, n);
+    triplet = Rotate(triplet, length, n);
+    ratchet[0] = Rotate(ratchet[0], length, n);
+    ratchet[1] = Rotate(ratchet[1], length, n);
+    for (uint8_t k = 0; k < 3; ++k) cond[k] = Rotate(cond[k], length, n);
+    uint8_t tmp[MAX_STEPS];
+    for (uint8_t i = 0; i < length; ++i) tmp[i] = pitch[i];
+    for (uint8_t i = 0; i < length; ++i) {
+      const uint8_t j = i + pn;
+      pitch[j < length ? j : j - length] = tmp[i];
+    }
+  }
+  void Reverse() {
+    accent = Reverse(accent, length);
+    slide = Reverse(slide, length);
+    note = Reverse(note, length);
+    tie = Reverse(tie, length);
+    triplet = Reverse(triplet, length);
+    ratchet[0] = Reverse(ratchet[0], length);
+    ratchet[1] = Reverse(ratchet[1], length);
+    for (uint8_t k = 0; k < 3; ++k) cond[k] = Reverse(cond[k], length);
+    for (uint8_t i = 0, j = length - 1; i < j; ++i, --j) {
+      const uint8_t tmp = pitch[i];
+      pitch[i] = pitch[j];
+      pitch[j] = tmp;
+    }
+  }
+
+  // from the EEPROM layout
+  void Import(const Sequence &seq) {
+    accent = slide = note = tie = triplet = 0;
+    ratchet[0] = ratchet[1] = 0;
+    cond[0] = cond[1] = cond[2] = 0;
+    length = seq.length;
+    uint8_t p = 0;
+    for (uint8_t t = 0; t < length; ++t) {
+      const uint8_t tm = seq.time(t);
+      if (t > 0 && (tm & TIME_NOTE)) ++p;
+      const uint8_t data = seq.pitch[p];
+      pitch[t] = data & 0x3f;
+      if (data & (1<<6)) accent |= Bit(t);
+      if (data & (1<<7)) slide |= Bit(t);
+      if (tm == TIME_TIE) tie |= Bit(t);
+      else if (tm) note |= Bit(t);
+      if (tm == TIME_TRIPLET) triplet |= Bit(t);
+      const uint8_t r = seq.ratchet(t);
+      if (r & 1) ratchet[0] |= Bit(t);
+      if (r & 2) ratchet[1] |= Bit(t);
+      const uint8_t c = seq.condition(t);
+      for (uint8_t k = 0; k < 3; ++k) {
+        if (c & (1 << k)) cond[k] |= Bit(t);
+      }
+    }
+  }
+  // back to the EEPROM layout, packing pitches in note order
+  void Export(Sequence &seq) const {
+    seq.length = length;
+    uint8_t p = 0;
+    for (uint8_t t = 0; t < length; ++t) {
+      const uint8_t tm = is_note(t) ? ((triplet & Bit(t)) ? TIME_TRIPLET : TIME_NOTE)
+                       : (tie & Bit(t)) ? TIME_TIE : TIME_REST;
+      const uint8_t r = ((ratchet[0] & Bit(t)) ? 1 : 0) | ((ratchet[1] & Bit(t)) ? 2 : 0);
+      const uint8_t upper = t & 1;
+      uint8_t &data = seq.time_data[t >> 1];
+      data = (~(0x0f << 4*upper) & data) | ((tm | r << 2) << 4*upper);
+      seq.SetConditionAt(t, ((cond[0] & Bit(t)) ? 1 : 0) | ((cond[1] & Bit(t)) ? 2 : 0)
+                          | ((cond[2] & Bit(t)) ? 4 : 0));
+
+      if (t > 0 && (tm & TIME_NOTE)) ++p;
+      if (t == 0 || (tm & TIME_NOTE)) {
+        seq.pitch[p] = pitch[t] | (get_accent(t) << 6) | (get_slide(t) << 7);
+      }
+    }
   }
 };
 
 // --- EEPROM data layout
 static constexpr int SETTINGS_SIZE = 128;
 static constexpr int PATTERN_SIZE = MAX_STEPS * 2;
-const char* const sig_pew = "PewPewPew!!!";
+static constexpr int NUDGE_SIZE = MAX_STEPS / 2; // 4 bits per step, after all the patterns
+static constexpr int NUDGE_BASE = SETTINGS_SIZE + NUM_PATTERNS * PATTERN_SIZE;
+static constexpr uint8_t NUDGES_SAVED = 0x5a; // PersistentSettings::nudges once the block is written
+static constexpr uint8_t STEP_FLAGS_LAYOUT = 0xa5; // PersistentSettings::layout once old patterns are cleaned
+static_assert(offsetof(Sequence, length) == PATTERN_SIZE - 1, "Sequence storage must be 64 bytes");
+static_assert(EditHistory::DATA_SIZE == PATTERN_SIZE, "undo records cover the pattern storage");
+const char sig_pew[] PROGMEM = "PewPewPew!!!";
 
 extern EEPROMClass storage;
 
 struct PersistentSettings {
   char signature[16];
+  uint8_t clock_ratio; // ClockRatio
+  uint8_t nudges; // NUDGES_SAVED, else the nudge block is blank EEPROM
+  uint8_t swing;  // percent, see Engine::SetSwing()
+  uint8_t layout; // STEP_FLAGS_LAYOUT, else patterns may hold old firmware's random bytes
 
   void Load() {
-    storage.get(0, signature);
+    storage.get(0, *this);
   }
   void Save() {
-    storage.put(0, signature);
+    storage.put(0, *this);
   }
-  bool Validate() const {
-    if (0 == strncmp(signature, sig_pew, 12))
+  bool Validate() {
+    if (0 == strncmp_P(signature, sig_pew, 12))
       return true;
 
-    strcpy((char*)signature, sig_pew);
+    strcpy_P(signature, sig_pew);
+    clock_ratio = 0;
+    nudges = 0;
+    swing = 50;
+    layout = 0;
     return false;
   }
 };
+static_assert(sizeof(PersistentSettings) <= SETTINGS_SIZE, "settings overlap the patterns");
 
 extern PersistentSettings GlobalSettings;
 
@@ -184,12 +578,207 @@ void ReadPattern(Sequence &seq, int idx) {
     dst[i] = storage.read(SETTINGS_SIZE + idx + i);
   }
 }
+void WriteNudges(const uint8_t *src, int idx) {
+  for (uint8_t i = 0; i < NUDGE_SIZE; ++i) {
+    storage.update(NUDGE_BASE + idx * NUDGE_SIZE + i, src[i]);
+  }
+}
+void ReadNudges(uint8_t *dst, int idx) {
+  for (uint8_t i = 0; i < NUDGE_SIZE; ++i) {
+    dst[i] = storage.read(NUDGE_BASE + idx * NUDGE_SIZE + i);
+  }
+}
+
+// when a queued pattern takes over
+enum CueQuantum : uint8_t {
+  CUE_STEP,
+  CUE_BEAT,
+  CUE_BAR,
+  CUE_PATTERN, // the original behaviour - wait for the end of the pattern
+
+  CUE_COUNT
+};
+static constexpr uint8_t BAR_TICKS = 96; // 4/4 at 24ppqn
+
+// A factory preset, read in place from flash through the same accessors
+// CompileSteps() uses on a Sequence. Layout as in Sequence storage.
+struct FlashPattern {
+  const uint8_t *data; // PROGMEM
+
+  uint8_t byte(uint8_t i) const { return pgm_read_byte(data + i); }
+  uint8_t steps() const {
+    const uint8_t len = byte(PATTERN_SIZE - 1);
+    return (len == 0 || len > MAX_STEPS) ? 8 : len;
+  }
+  uint8_t pitch_at(uint8_t idx) const { return byte(idx); }
+  uint8_t time(uint8_t idx) const {
+    return (byte(MAX_STEPS + (idx >> 1)) >> (4*(idx & 1))) & 0x3;
+  }
+  uint8_t ratchet(uint8_t idx) const {
+    return (byte(MAX_STEPS + (idx >> 1)) >> (4*(idx & 1) + 2)) & 0x3;
+  }
+  uint8_t condition(uint8_t idx) const {
+    const uint8_t base = MAX_STEPS + MAX_STEPS/2 + 1 + (idx >> 3), bit = idx & 7;
+    return (byte(base) >> bit & 1) | (byte(base + MAX_STEPS/8) >> bit & 1) << 1
+         | (byte(base + MAX_STEPS/4) >> bit & 1) << 2;
+  }
+  uint8_t mod_conditions() const { return byte(PATTERN_SIZE - 3); }
+  StepTiming get_timing(bool triplet) const {
+    const uint8_t res = byte(MAX_STEPS + MAX_STEPS/2);
+    return step_timing[(res < RES_COUNT ? res : 0) << 1 | triplet];
+  }
+};
+static_assert(sizeof(presets[0]) == PATTERN_SIZE, "presets must use the Sequence storage layout");
+
+// Second lane - plays any pattern slot as MIDI notes, beside the CV lane.
+// Reads the published pattern directly, one step at a time, so each tick
+// costs the same whatever the pattern holds. Notes are left in on_/off_
+// for the main loop to send; at most one of each per tick.
+struct MidiLane {
+  static constexpr uint8_t NO_NOTE = 0xff;
+  static constexpr uint8_t NOTE_BASE = 24; // MIDI note for pitch 0 - OCTAVE_ZERO C is 36
+  static constexpr uint8_t MAX_DIV = 8;
+
+  // settings
+  uint8_t pattern = 1;
+  uint8_t length = 0;  // 0 follows the pattern, else 1-32 steps of its storage
+  uint8_t div = 1;     // clock division, steps last div times longer
+  uint8_t channel = 0; // MIDI channel 1-16, 0 is off
+
+  // playhead
+  uint8_t time_pos = 0, pitch_pos = 0;
+  bool reset = true;
+  int8_t count_ = -1; // ticks into the step
+  uint8_t step_ticks_ = 6, gate_ticks_ = 3;
+  bool hold_ = false; // slide or tie, note carries into the next step
+  uint8_t sounding_ = NO_NOTE;
+  uint8_t sounding_channel_ = 0; // a note ends on the channel it started on
+
+  // waiting for the main loop
+  uint8_t on_ = NO_NOTE, off_ = NO_NOTE;
+  uint8_t velocity_ = 0, off_channel_ = 0;
+
+  bool enabled() const { return channel != 0; }
+  uint8_t steps(const Sequence &seq) const { return length ? length : seq.length; }
+
+  void Reset() {
+    Release();
+    time_pos = pitch_pos = 0;
+    reset = true;
+    count_ = -1;
+  }
+  void Release() {
+    if (sounding_ == NO_NOTE) return;
+    if (on_ == sounding_) on_ = NO_NOTE; // never went out
+    else EndNote();
+    sounding_ = NO_NOTE;
+    hold_ = false;
+  }
+
+  void Clock(const Sequence &seq, int8_t transpose) {
+    if (++count_ >= step_ticks_) count_ = 0;
+    if (count_ == 0)
+      Step(seq, transpose);
+    else if (count_ == gate_ticks_ && !hold_)
+      Release();
+  }
+
+  // same pitch_pos walk as Sequence::Advance()
+  void Step(const Sequence &seq, int8_t transpose) {
+    const uint8_t len = steps(seq);
+    if (reset) reset = false;
+    else if (++time_pos >= len) time_pos = 0;
+    else if (seq.time(time_pos) & TIME_NOTE) ++pitch_pos;
+    if (time_pos >= len) time_pos = 0; // pattern or length changed under us
+    if (time_pos == 0) pitch_pos = 0;
+
+    const uint8_t tm = seq.time(time_pos);
+    const StepTiming t = seq.get_timing(tm == TIME_TRIPLET);
+    step_ticks_ = t.step * div;
+    gate_ticks_ = t.gate * div;
+
+    if (tm == TIME_REST) {
+      Release();
+      return;
+    }
+    const uint8_t data = seq.pitch[pitch_pos];
+    const bool tied = seq.time(time_pos + 1 >= len ? 0 : time_pos + 1) == TIME_TIE;
+    const bool was_held = hold_;
+    hold_ = (data & (1<<7)) || tied;
+    const uint8_t p = TransposePitch(data & 0x3f, transpose);
+    const uint8_t note = NOTE_BASE + (p & 0x0f) + 12 * (p >> 4);
+    if (tm == TIME_TIE && was_held && note == sounding_) return; // carries on
+    if (sounding_ != NO_NOTE) EndNote(); // slide - new note before the old one ends
+    on_ = sounding_ = note;
+    sounding_channel_ = channel;
+    velocity_ = (data & (1<<6)) ? 127 : 96;
+  }
+  void EndNote() {
+    off_ = sounding_;
+    off_channel_ = sounding_channel_;
+  }
+
+  // place the playhead so the next Clock() plays the given tick
+  void Locate(const Sequence &seq, uint32_t song_tick) {
+    Release();
+    const uint8_t len = steps(seq);
+    uint16_t pass = 0;
+    for (uint8_t i = 0; i < len; ++i)
+      pass += seq.get_timing(seq.time(i) == TIME_TRIPLET).step * div;
+    uint16_t tick = song_tick % pass;
+
+    uint8_t p = 0;
+    for (uint8_t i = 0; i < len; ++i) {
+      const uint8_t tm = seq.time(i);
+      if (i > 0 && (tm & TIME_NOTE)) ++p;
+      const StepTiming t = seq.get_timing(tm == TIME_TRIPLET);
+      if (tick < t.step * div) {
+        time_pos = i;
+        pitch_pos = p;
+        reset = (tick == 0);
+        count_ = int8_t(tick) - 1;
+        step_ticks_ = t.step * div;
+        gate_ticks_ = t.gate * div;
+        return; // mid-step, the note waits for the next step
+      }
+      tick -= t.step * div;
+    }
+  }
+
+  // hand the pending notes to the caller - note on goes to channel
+  bool Take(uint8_t &on, uint8_t &velocity, uint8_t &off, uint8_t &off_channel) {
+    if (on_ == NO_NOTE && off_ == NO_NOTE) return false;
+    on = on_;
+    velocity = velocity_;
+    off = off_;
+    off_channel = off_channel_;
+    on_ = off_ = NO_NOTE;
+    return true;
+  }
+};
+
+// Edits never touch a pattern the clock is reading. They go to a copy in the
+// spare slot, which the clock side publishes at a step boundary by swapping
+// one slot index - a single byte store, so the clock never masks interrupts.
+// The editor owns the shadow until READY; the clock owns it from then until FREE.
+// There's one shadow, so an edit to another pattern has to wait for a pending
+// edit of the playing one to be published - see Engine::editable().
+enum ShadowState : uint8_t {
+  SHADOW_FREE,
+  SHADOW_EDITING,
+  SHADOW_READY, // waiting for the next step boundary
+};
 
 struct Engine {
   //elapsedMillis delay_timer = 0;
 
-  // pattern storage
-  Sequence pattern[NUM_PATTERNS]; // 32 steps each
+  // pattern storage - one slot more than patterns, for the shadow
+  Sequence slots_[NUM_PATTERNS + 1]; // 32 steps each
+  uint8_t slot_of_[NUM_PATTERNS]; // pattern -> slot
+  uint8_t spare_ = NUM_PATTERNS;  // slot holding the shadow
+  uint8_t shadow_of_ = 0;         // pattern the shadow will replace
+  volatile uint8_t shadow_state_ = SHADOW_FREE;
+
   uint8_t p_select = 0;
   uint8_t next_p = 0; // queued pattern
                       // TODO: start & end for chains
@@ -198,55 +787,127 @@ struct Engine {
   //uint8_t chains[16][7]; // 7 tracks, up to 16 chained patterns
 
   int8_t clk_count = -1;
+  StepTiming timing_ = {6, 3, 2}; // current step
+  int8_t bar_tick_ = -1; // position in the bar, for cues
+  CueQuantum cue_ = CUE_PATTERN;
 
   bool slide_on = false; // flag to keep raised
   bool stale = false;
   bool resting = false; // hey shutup
 
+  // compiled output for the playing pattern
+  StepOutput step_table[MAX_STEPS];
+  uint16_t pass_ticks_ = 0; // clock ticks in one pass of the pattern
+  uint8_t table_len_ = 0; // steps in the table
+
+  // factory preset playing from flash in place of the user pattern, or -1.
+  // The user pattern's playhead carries on through it.
+  int16_t preset_ = -1;
+  bool dirty_ = true; // table needs a rebuild
+  uint8_t mod_cond_ = 0; // accent and slide conditions of the compiled pattern
+
+  // trigger conditions
+  uint16_t loops_ = 0; // passes through the playing pattern, from 0
+  uint8_t mute_ = 0;   // port bits the current step's conditions took out
+
+  // swing and nudges - the engine stays on the grid, main.cpp holds a late
+  // step's output back on a timer (swing.h) and calls Onset() when it's due
+  static constexpr uint8_t MAX_LATE = 48; // 64ths of a step
+  uint8_t swing_ = 50; // percent of a step pair the first one gets, 50-75
+  uint8_t nudges_[NUM_PATTERNS][NUDGE_SIZE] = {}; // 1/32 steps late, a nibble per step slot
+  int8_t lag_ = 0; // ticks into the step when the note came out
+  int8_t transpose_ = 0; // semitones
+  int8_t octave_shift_ = 0;
+
+  // generator
+  GenParams gen;
+  Xorshift rng;
+
+  MidiLane lane; // second voice, MIDI out only
+
+  // arpeggiator - replaces the pattern's notes while on, on the pattern's step grid
+  Arp arp;
+  bool arp_on_ = false;
+  StepOutput arp_out_ = {};
+
+  // undo - every BeginEdit() / EndEdit() pair is a record, a held Generate() is one
+  EditHistory history;
+  bool grouped_ = false;  // the open record is a Generate() run
+  bool generating_ = false;
+  bool replaying_ = false; // an undo or redo is going through the shadow
+
+  Engine() {
+    for (uint8_t i = 0; i < NUM_PATTERNS; ++i) slot_of_[i] = i;
+  }
+
   // actions
   void Load() {
-    Serial.println("Loading from EEPROM...");
-
     // TODO: settings and calibration
     GlobalSettings.Load();
-    if (GlobalSettings.Validate()) {
+    const bool valid = GlobalSettings.Validate();
+    Telemetry::Log(EV_LOAD, valid);
+    if (valid) {
       for (uint8_t i = 0; i < NUM_PATTERNS; ++i) {
-        ReadPattern(pattern[i], i);
-        if (0 == pattern[i].length) pattern[i].SetLength(8);
+        ReadPattern(pattern(i), i);
+        if (0 == pattern(i).length || pattern(i).length > MAX_STEPS) pattern(i).SetLength(8);
       }
     } else {
-      Serial.println("EEPROM data invalid, initializing...");
       // initialize memory with defaults or zeroes
       for (uint8_t i = 0; i < NUM_PATTERNS; ++i) {
-        pattern[i].Clear();
+        pattern(i).Clear();
       }
       GlobalSettings.Save();
       stale = true;
       Save();
     }
+    if (valid && GlobalSettings.nudges == NUDGES_SAVED) {
+      for (uint8_t i = 0; i < NUM_PATTERNS; ++i) ReadNudges(nudges_[i], i);
+    } else {
+      // first boot since the nudge block was added - start it clear
+      for (uint8_t i = 0; i < NUM_PATTERNS; ++i) WriteNudges(nudges_[i], i);
+      GlobalSettings.nudges = NUDGES_SAVED;
+      GlobalSettings.swing = 50;
+      GlobalSettings.Save();
+    }
+    if (GlobalSettings.layout != STEP_FLAGS_LAYOUT) {
+      // RegenTime() on the old firmware filled time_data past its end with
+      // random bytes - which now read as ratchets, conditions and resolution
+      for (uint8_t i = 0; i < NUM_PATTERNS; ++i) pattern(i).ClearStepFlags();
+      stale = true;
+      Save();
+      GlobalSettings.layout = STEP_FLAGS_LAYOUT;
+      GlobalSettings.Save();
+    }
+    dirty_ = true;
 
 #if DEBUG
-    Serial.println("First pattern:");
+    Serial.println(F("First pattern:"));
     for (uint8_t i = 0; i < 64; ++i) {
-      Serial.printf("%2x ", pattern[0].pitch[i]);
+      Serial.printf("%2x ", pattern(0).pitch[i]);
     }
     Serial.print("\n");
 #endif
   }
   void Save(int pidx = -1) {
+    Publish();
     if (!stale) return;
-    Serial.print("Saving to EEPROM... ");
+    // one record each side - a per-pattern one would overrun the telemetry ring
+    const uint32_t start = millis();
     if (pidx < 0) {
       // save all
+      Telemetry::Log(EV_SAVE, 0, NUM_PATTERNS);
       for (uint8_t i = 0; i < NUM_PATTERNS; ++i) {
-        Serial.print(".");
-        WritePattern(pattern[i], i);
+        WritePattern(pattern(i), i);
+        WriteNudges(nudges_[i], i);
       }
-    } else
-      WritePattern(pattern[pidx], pidx);
+    } else {
+      Telemetry::Log(EV_SAVE, pidx, 1);
+      WritePattern(pattern(pidx), pidx);
+      WriteNudges(nudges_[pidx], pidx);
+    }
 
     stale = false;
-    Serial.println("DONE!");
+    Telemetry::Log(EV_SAVE_DONE, 0, millis() - start);
   }
 
   void Tick(uint8_t &state) {
@@ -257,65 +918,532 @@ struct Engine {
     // gate_on = get_gate();
   }
 
+  // --- shadow edits
+  // Can pattern idx be edited right now? Not while the shadow holds an edit
+  // of the playing pattern that hasn't reached its step boundary - handing
+  // the shadow over would publish that one mid-step. A pending edit of any
+  // other pattern can go out early, nothing is reading it. Cross-pattern
+  // callers check this and refuse; panel edits are always to the playing one.
+  bool editable(uint8_t idx) const {
+    return shadow_state_ == SHADOW_FREE || shadow_of_ == idx || shadow_of_ != p_select;
+  }
+  // copy of pattern idx to edit, taking the playhead from the live one - only when editable(idx)
+  Sequence &BeginEdit(uint8_t idx) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (shadow_state_ != SHADOW_FREE && shadow_of_ != idx) Swap(); // one shadow at a time, never the playing one's
+      if (shadow_state_ == SHADOW_FREE) {
+        slots_[spare_] = pattern(idx);
+        shadow_of_ = idx;
+      }
+      shadow_state_ = SHADOW_EDITING; // reclaims a READY shadow before the clock takes it
+    }
+    Sequence &shadow = slots_[spare_];
+    const Sequence &live = pattern(idx);
+    shadow.pitch_pos = live.pitch_pos;
+    shadow.time_pos = live.time_pos;
+    shadow.reset = live.reset;
+    if (!replaying_) Track(idx, shadow);
+    Recorder::EditBegin(shadow.pitch, rng.state);
+    return shadow;
+  }
+  Sequence &BeginEdit() { return BeginEdit(p_select); }
+  void EndEdit() {
+    if (!replaying_ && !grouped_) history.Close(slots_[spare_].pitch);
+    Recorder::EditEnd(shadow_of_, slots_[spare_].pitch, rng.state);
+    stale = true;
+    dirty_ = true;
+    shadow_state_ = SHADOW_READY;
+  }
+
+  // --- undo history
+  // start a record for an edit of pattern idx, unless it carries on a Generate() run
+  void Track(uint8_t idx, const Sequence &shadow) {
+    if (history.open() == idx && generating_ && grouped_) return;
+    CloseEdits();
+    history.Open(idx, shadow.pitch);
+    grouped_ = generating_;
+  }
+  // a Generate() run is over when its keys are let go
+  void EndGenerate() {
+    if (grouped_) CloseEdits();
+  }
+  void CloseEdits() {
+    if (history.open() != EditHistory::NONE) history.Close(peek_pattern(history.open()).pitch);
+    grouped_ = false;
+  }
+  // returns the pattern that changed, or EditHistory::NONE - also when that
+  // pattern isn't editable() yet, so try again after the next step
+  uint8_t Undo() { return Replay(true); }
+  uint8_t Redo() { return Replay(false); }
+  // the pattern the next Undo() or Redo() changes
+  uint8_t replay_target(bool undo) {
+    CloseEdits();
+    return undo ? history.undo_target() : history.redo_target();
+  }
+  uint8_t Replay(bool undo) {
+    const uint8_t idx = replay_target(undo);
+    if (idx == EditHistory::NONE || !editable(idx)) return EditHistory::NONE;
+    replaying_ = true;
+    Sequence &seq = BeginEdit(idx);
+    if (undo) history.Undo(seq.pitch);
+    else history.Redo(seq.pitch);
+    seq.SetResolution(seq.resolution);
+    seq.SetLength(seq.length);
+    EndEdit();
+    replaying_ = false;
+    return idx;
+  }
+
+  // clock side - called at step boundaries, or any time while stopped
+  void Publish() {
+    if (shadow_state_ != SHADOW_READY) return;
+    Recorder::Log(REC_PUBLISH);
+    Swap();
+  }
+  void Swap() {
+    Sequence &next = slots_[spare_];
+    const uint8_t old = slot_of_[shadow_of_];
+    const Sequence &live = slots_[old];
+    next.pitch_pos = live.pitch_pos;
+    next.time_pos = live.time_pos;
+    next.reset = live.reset;
+    next.SetLength(next.length); // playhead inside a shortened pattern
+
+    slot_of_[shadow_of_] = spare_; // the publish
+    spare_ = old;
+    if (shadow_of_ == p_select) dirty_ = true;
+    asm volatile("" ::: "memory"); // slot writes land before the editor sees FREE
+    shadow_state_ = SHADOW_FREE;
+  }
+
+  // cheap sanity checks once per step - repair and report instead of corrupting memory
+  void CheckInvariants() {
+    uint8_t fault = 0;
+    if (p_select >= NUM_PATTERNS) { p_select &= 0xf; fault |= 1; }
+    if (next_p >= NUM_PATTERNS) { next_p &= 0xf; fault |= 2; }
+    Sequence &seq = get_sequence();
+    if (preset_ < 0 && !seq.Valid()) {
+      seq.SetLength(seq.length);
+      fault |= 4;
+    }
+    if (fault) {
+      Telemetry::Log(EV_FAULT, fault, p_select);
+      dirty_ = true;
+    }
+  }
+
   // returns false for rests
   bool Advance() {
+    if (preset_ >= 0) return CheckConditions(AdvancePreset());
+    CheckInvariants();
+    const bool restart = get_sequence().reset;
     bool result = get_sequence().Advance();
+    if (!restart && 0 == get_sequence().time_pos) ++loops_;
     // jump to next pattern at end of current one
-    if (0 == get_sequence().time_pos && next_p != p_select) {
+    if (cue_ == CUE_PATTERN && 0 == get_sequence().time_pos && next_p != p_select) {
       p_select = next_p;
+      Telemetry::Log(EV_PATTERN, p_select);
+      Compile();
       get_sequence().Reset();
       result = get_sequence().Advance();
+      loops_ = 0;
     }
     if (result) {
       slide_on = get_slide() || get_sequence().is_tied();
     }
+    const Sequence &seq = get_sequence();
+    timing_ = seq.get_timing(seq.get_time() == TIME_TRIPLET);
+    return CheckConditions(result);
+  }
+  // by hand, off the clock - TAP_NEXT and step entry. Logged, Clock()'s aren't.
+  bool Step() {
+    Recorder::Log(REC_ADVANCE, 0);
+    return Advance();
+  }
+  void StepPitch() {
+    Recorder::Log(REC_ADVANCE, 1);
+    get_sequence().AdvancePitch();
+  }
+
+  // Roll the new step's conditions: a note that fails rests, a failed
+  // accent or slide is masked out of the port bits for the step. A table
+  // read and a few shifts per step - see tools/condbench.cpp.
+  bool CheckConditions(bool gate) {
+    mute_ = 0;
+    if (!gate) return false;
+    if (dirty_) Compile();
+    const StepOutput &out = step_table[get_sequence().time_pos];
+    if (out.cond && !Pass(out.cond)) return false;
+    if ((out.ctrl & DAC::ACCENT_BIT) && !Pass(mod_cond_ & 0x7)) mute_ |= DAC::ACCENT_BIT;
+    if ((out.ctrl & DAC::SLIDE_BIT) && !Pass(mod_cond_ >> 4 & 0x7)) {
+      mute_ |= DAC::SLIDE_BIT;
+      slide_on = out.flags & STEP_TIED;
+    }
+    return true;
+  }
+  bool Pass(uint8_t cond) {
+    switch (cond) {
+      case COND_75: return rng.Chance(192);
+      case COND_50: return rng.Chance(128);
+      case COND_25: return rng.Chance(64);
+      case COND_12: return rng.Chance(32);
+      case COND_FIRST: return loops_ == 0;
+      case COND_EVERY_2: return (loops_ & 1) == 1;
+      case COND_EVERY_4: return (loops_ & 3) == 3;
+      default: return true;
+    }
+  }
+
+  // the flash copy is never written - presets step through the compiled table
+  bool AdvancePreset() {
+    if (dirty_) Compile();
+    Sequence &head = get_sequence();
+    if (head.reset) head.reset = false;
+    else if (++head.time_pos >= table_len_) {
+      head.time_pos = 0;
+      ++loops_;
+    }
+    const StepOutput &out = step_table[head.time_pos];
+    head.pitch_pos = out.pitch_pos;
+    const bool result = out.flags & STEP_GATE;
+    if (result) slide_on = out.flags & STEP_HOLD;
+    timing_ = FlashPattern{presets[preset_]}.get_timing(out.flags & STEP_TRIPLET);
     return result;
   }
 
   // returns true for new pitch step
   bool Clock() {
     bool send_note = false;
-    ++clk_count %= 6;
+    if (next_p != p_select && cue_due()) Cue();
+    if (++bar_tick_ >= BAR_TICKS) bar_tick_ = 0;
+    if (step_due()) {
+      // pick up edits before the new step is read
+      Publish();
+      if (dirty_) Compile();
+    }
+    if (++clk_count >= timing_.step) clk_count = 0;
 
-    if (clk_count == 0) { // sixteenth note advance
+    if (clk_count == 0) { // step advance
+      lag_ = 0;
       send_note = Advance();
+      if (arp_on_) send_note = ArpStep();
       //delay_timer = 0;
       resting = !send_note;
     }
+    if (lane.enabled()) lane.Clock(pattern(lane.pattern), get_transpose());
 
     return send_note;
   }
 
+  // next held note, from C at OCTAVE_ZERO - the pattern keeps its place underneath
+  bool ArpStep() {
+    const uint8_t semi = arp.Next(uint8_t(rng.Next()));
+    if (semi == Arp::NO_NOTE) return false;
+    arp_out_.cv = TransposePitch(OCTAVE_ZERO << 4, semi + get_transpose());
+    arp_out_.ctrl = DAC::GATE_BIT;
+    arp_out_.flags = STEP_GATE;
+    slide_on = false;
+    return true;
+  }
+
   void Reset() {
+    Recorder::Log(REC_RESET);
     get_sequence().Reset();
+    arp.Restart();
+    lane.Reset();
     clk_count = -1;
+    bar_tick_ = -1;
     slide_on = false;
     resting = true;
+    loops_ = 0;
+    mute_ = 0;
+    lag_ = 0;
   }
 
+  void Compile() {
+    const int8_t transpose = transpose_ + 12 * octave_shift_;
+    if (preset_ >= 0) {
+      const FlashPattern src = { presets[preset_] };
+      table_len_ = src.steps();
+      pass_ticks_ = CompileSteps(src, step_table, transpose);
+      mod_cond_ = src.mod_conditions();
+    } else {
+      table_len_ = get_sequence().length;
+      pass_ticks_ = get_sequence().Compile(step_table, transpose);
+      mod_cond_ = get_sequence().mod_conditions;
+    }
+    dirty_ = false;
+  }
+
+  // does the next tick fall on the cue quantum?
+  bool cue_due() const {
+    const int8_t next = bar_tick_ + 1;
+    switch (cue_) {
+      case CUE_STEP: return step_due();
+      case CUE_BEAT: return next % 24 == 0;
+      case CUE_BAR: return next >= BAR_TICKS || next == 0;
+      default: return false; // pattern end is handled by Advance()
+    }
+  }
+  // Switch to the queued pattern on this tick, phase-aligned: it picks up
+  // at the same tick offset the playing pattern had reached, wrapped to its
+  // own length, so the step grid carries on without a gap or a repeat.
+  void Cue() {
+    const uint16_t tick = step_table[get_sequence().time_pos].start + clk_count + 1;
+    if (preset_ >= 0) get_sequence().SetLength(get_sequence().length); // a preset was driving its playhead
+    p_select = next_p;
+    Telemetry::Log(EV_PATTERN, p_select);
+    dirty_ = true;
+    Locate(tick);
+  }
+
+  // Jump to a song position in clock ticks (a MIDI Song Position times 6,
+  // scaled by the clock ratio), so the next Clock() plays that tick. The
+  // pattern is taken to loop from position 0; the step comes from the
+  // compiled start ticks, not from replaying the clock.
+  void Relocate(uint32_t tick) {
+    bar_tick_ = int8_t((tick + BAR_TICKS - 1) % BAR_TICKS);
+    Locate(tick);
+    lane.Locate(pattern(lane.pattern), tick);
+  }
+  // place the playhead so the next Clock() plays the given tick of the pattern
+  void Locate(uint32_t song_tick) {
+    Publish();
+    if (dirty_) Compile();
+    Sequence &seq = get_sequence();
+    const uint16_t tick = song_tick % pass_ticks_;
+
+    // last step starting at or before the tick
+    uint8_t lo = 0, hi = table_len_;
+    while (hi - lo > 1) {
+      const uint8_t mid = (lo + hi) >> 1;
+      if (step_table[mid].start <= tick) lo = mid;
+      else hi = mid;
+    }
+    const StepOutput &out = step_table[lo];
+    const uint8_t offset = tick - out.start;
+    loops_ = song_tick / pass_ticks_;
+    mute_ = 0;
+    lag_ = 0;
+
+    seq.time_pos = lo;
+    seq.pitch_pos = out.pitch_pos;
+    seq.reset = (offset == 0); // Clock() lands on this step instead of the next
+    clk_count = int8_t(offset) - 1;
+    timing_ = (preset_ >= 0) ? FlashPattern{presets[preset_]}.get_timing(out.flags & STEP_TRIPLET)
+                             : seq.get_timing(out.flags & STEP_TRIPLET);
+    resting = !(out.flags & STEP_GATE) || offset == 0;
+    slide_on = !resting && (out.flags & STEP_HOLD);
+  }
+
+  // one step at a time, while CLEAR + BACK are held
   void Generate() {
+    if (mode_ != PITCH_MODE && mode_ != TIME_MODE) return;
+    generating_ = true;
     if (mode_ == PITCH_MODE)
-      get_sequence().RegenPitch();
-    else if (mode_ == TIME_MODE)
-      get_sequence().RegenTime();
+      BeginEdit().RegenPitch(rng, gen);
+    else
+      BeginEdit().RegenTime(rng, gen);
+    EndEdit();
+    generating_ = false;
+  }
+  // whole pattern - same seed and params always give the same pattern
+  bool GeneratePattern(uint8_t idx) {
+    if (!editable(idx)) return false;
+    Xorshift prng;
+    prng.Seed(gen.seed ^ (uint16_t(idx) << 8));
+    Sequence &seq = BeginEdit(idx);
+    const int pp = seq.pitch_pos, tp = seq.time_pos;
+    for (uint8_t i = 0; i < seq.length; ++i) {
+      seq.pitch_pos = seq.time_pos = i;
+      seq.RegenPitch(prng, gen);
+      seq.RegenTime(prng, gen);
+    }
+    seq.pitch_pos = pp;
+    seq.time_pos = tp;
+    EndEdit();
+    return true;
   }
 
-  void ClearPattern(uint8_t idx) {
-    pattern[idx].Clear();
+  // whole-pattern edits via the bit-plane view
+  void RotatePattern(uint8_t n) {
+    StepPlanes planes;
+    Sequence &seq = BeginEdit();
+    planes.Import(seq);
+    planes.Rotate(n);
+    planes.Export(seq);
+    EndEdit();
+  }
+  void ReversePattern() {
+    StepPlanes planes;
+    Sequence &seq = BeginEdit();
+    planes.Import(seq);
+    planes.Reverse();
+    planes.Export(seq);
+    EndEdit();
+  }
+
+  bool ClearPattern(uint8_t idx) {
+    if (!editable(idx)) return false;
+    BeginEdit(idx).Clear();
+    EndEdit();
+    return true;
   }
 
+  // remote edits - any pattern slot, raw storage bytes.
+  // These return false, and change nothing, when the slot isn't editable().
+  bool ImportPattern(uint8_t idx, const uint8_t *data) {
+    if (!editable(idx & 0xf)) return false;
+    Sequence &seq = BeginEdit(idx & 0xf);
+    memcpy(seq.pitch, data, PATTERN_SIZE);
+    seq.SetResolution(seq.resolution);
+    seq.SetLength(seq.length);
+    EndEdit();
+    return true;
+  }
+  // pitch and time are separate lanes, as on the 303 - step indexes both
+  bool SetStep(uint8_t idx, uint8_t step, uint8_t pitch, uint8_t time) {
+    if (!editable(idx & 0xf)) return false;
+    Sequence &seq = BeginEdit(idx & 0xf);
+    step &= MAX_STEPS - 1;
+    seq.pitch[step] = pitch;
+    seq.SetTimeAt(step, time);
+    EndEdit();
+    return true;
+  }
+  bool SetPatternLength(uint8_t idx, uint8_t len) {
+    if (!editable(idx & 0xf)) return false;
+    BeginEdit(idx & 0xf).SetLength(len);
+    EndEdit();
+    return true;
+  }
+  // the late step's note is out - its gate and accent time from here
+  void Onset() { lag_ = clk_count; }
+  void SetSwing(uint8_t percent) {
+    CONSTRAIN(percent, 50, 75);
+    swing_ = percent;
+  }
+  // per step slot, so rotate and reverse leave them where they are
+  void SetNudge(uint8_t idx, uint8_t step, uint8_t n) {
+    step &= MAX_STEPS - 1;
+    uint8_t &b = nudges_[idx & 0xf][step >> 1];
+    b = (step & 1) ? (b & 0x0f) | (n & 0xf) << 4 : (b & 0xf0) | (n & 0xf);
+    stale = true;
+  }
+  bool SetCondition(uint8_t idx, uint8_t step, uint8_t cond) {
+    if (!editable(idx & 0xf)) return false;
+    BeginEdit(idx & 0xf).SetConditionAt(step & (MAX_STEPS - 1), cond);
+    EndEdit();
+    return true;
+  }
+  // the condition on every accent, or every slide, of a pattern
+  bool SetModCondition(uint8_t idx, bool slide, uint8_t cond) {
+    if (!editable(idx & 0xf)) return false;
+    uint8_t &mod = BeginEdit(idx & 0xf).mod_conditions;
+    mod = slide ? (mod & 0x0f) | (cond & 0x7) << 4 : (mod & 0xf0) | (cond & 0x7);
+    EndEdit();
+    return true;
+  }
+
+  // factory presets - played from flash, taking over at the next step
+  void PlayPreset(uint16_t n) {
+    if (n >= PRESET_COUNT) return;
+    Recorder::Log(REC_PRESET, uint8_t(n), uint8_t(n >> 8));
+    preset_ = n;
+    dirty_ = true;
+  }
+  void StopPreset() {
+    if (preset_ < 0) return;
+    Recorder::Log(REC_PRESET, 0xff, 0xff);
+    preset_ = -1;
+    get_sequence().SetLength(get_sequence().length); // playhead back inside the user pattern
+    dirty_ = true;
+  }
+  // the only way a preset gets into SRAM - an explicit copy to a user slot
+  bool CopyPreset(uint16_t n, uint8_t idx) {
+    if (n >= PRESET_COUNT || !editable(idx & 0xf)) return false;
+    Sequence &seq = BeginEdit(idx & 0xf);
+    memcpy_P(seq.pitch, presets[n], PATTERN_SIZE);
+    seq.SetResolution(seq.resolution);
+    seq.SetLength(seq.length);
+    EndEdit();
+    return true;
+  }
+  int16_t get_preset() const { return preset_; }
+
   // getters
   SequencerMode get_mode() const { return mode_; }
 
-  Sequence &get_sequence() { return pattern[p_select]; }
-  const Sequence &get_sequence() const { return pattern[p_select]; }
+  // published patterns - what the clock plays
+  Sequence &pattern(uint8_t idx) { return slots_[slot_of_[idx]]; }
+  const Sequence &pattern(uint8_t idx) const { return slots_[slot_of_[idx]]; }
+  Sequence &get_sequence() { return pattern(p_select); }
+  const Sequence &get_sequence() const { return pattern(p_select); }
+  // latest contents, including edits not yet published
+  const Sequence &peek_pattern(uint8_t idx) const {
+    return (shadow_state_ != SHADOW_FREE && shadow_of_ == idx) ? slots_[spare_] : pattern(idx);
+  }
+
+  // compiled output for the current step
+  const StepOutput &current() const {
+    return arp_on_ ? arp_out_ : step_table[get_sequence().time_pos];
+  }
+  // final port bytes for the current step and tick
+  uint8_t get_cv() const {
+    return current().cv;
+  }
+  uint8_t get_ctrl() const {
+    const StepOutput &out = current();
+    if (resting) return out.ctrl & DAC::SLIDE_BIT & ~mute_;
+    uint8_t bits = out.ctrl & ~mute_;
+    // lengths count from the onset; a late note still lets go before the next step
+    const int8_t age = clk_count - lag_;
+    if (age >= timing_.accent && !(out.flags & STEP_TIED)) bits &= ~DAC::ACCENT_BIT;
+    if ((age >= timing_.gate || (lag_ && clk_count + 1 >= timing_.step)) && !holds(out))
+      bits &= ~DAC::GATE_BIT;
+    return bits;
+  }
+  // gate open for the whole step - a tie, or a slide its condition kept
+  bool holds(const StepOutput &out) const {
+    return (out.flags & STEP_TIED) || ((out.flags & STEP_HOLD) && !(mute_ & DAC::SLIDE_BIT));
+  }
+  // retriggers for the current step, 0 for none
+  uint8_t get_ratchet() const {
+    if (resting) return 0;
+    const uint8_t r = (current().flags & STEP_RATCHET) >> STEP_RATCHET_SHIFT;
+    return r ? r + 1 : 0;
+  }
+  bool get_hold() const {
+    return holds(current());
+  }
+  uint8_t get_step_ticks() const { return timing_.step; }
+  // 64ths of a step the step just started should sound late - swing on the
+  // off-beats plus its own nudge. Arp and preset steps only swing. The
+  // off-beats are counted on the bar, not the pattern, so an odd length
+  // doesn't flip the swing every time round.
+  uint8_t late_64ths() const {
+    const uint8_t pos = get_sequence().time_pos;
+    const uint8_t tick = bar_tick_ < 0 ? 0 : bar_tick_;
+    const bool off_beat = timing_.step && (tick / timing_.step) & 1;
+    uint8_t late = off_beat ? (swing_ - 50) * 64 / 50 : 0;
+    if (preset_ < 0 && !arp_on_) late += get_nudge(p_select, pos) * 2;
+    return late > MAX_LATE ? MAX_LATE : late;
+  }
+  uint8_t get_swing() const { return swing_; }
+  uint8_t get_nudge(uint8_t idx, uint8_t step) const {
+    const uint8_t b = nudges_[idx & 0xf][(step & (MAX_STEPS - 1)) >> 1];
+    return (step & 1) ? b >> 4 : b & 0xf;
+  }
+  bool step_start() const { return clk_count == 0; }
+  bool step_due() const { return clk_count < 0 || clk_count + 1 >= timing_.step; } // next Clock() starts a step
+  int8_t get_transpose() const { return transpose_ + 12 * octave_shift_; }
 
   bool get_gate() const {
     //delay_timer > 0 && 
-    return ((clk_count < 3) || slide_on) && !resting;
+    return ((clk_count < timing_.gate) || slide_on) && !resting;
   }
   bool get_accent() const {
-    return !resting && get_sequence().get_accent() && (clk_count < 2 || get_sequence().is_tied());
+    return !resting && get_sequence().get_accent() && (clk_count < timing_.accent || get_sequence().is_tied());
   }
   uint8_t get_pitch() const {
     return get_sequence().get_pitch();
@@ -341,47 +1469,158 @@ struct Engine {
 
   // setters
   void SetPattern(uint8_t p_, bool override = false) {
+    Recorder::Log(REC_SELECT, p_ & 0xf, override);
     next_p = p_ & 0xf; // p_ % 16;
-    if (override) p_select = next_p;
+    StopPreset(); // picking a user pattern leaves the preset
+    if (override) {
+      Publish();
+      p_select = next_p;
+      dirty_ = true;
+      // it carries on from wherever it was left, which the checkpoint doesn't have
+      const Sequence &seq = get_sequence();
+      Recorder::Log(REC_PLAYHEAD, seq.time_pos, seq.pitch_pos | seq.reset << 7);
+    }
   }
   void SetLength(uint8_t len) {
-    get_sequence().SetLength(len);
-    stale = true;
+    BeginEdit().SetLength(len);
+    EndEdit();
+  }
+  void CycleResolution() {
+    Sequence &seq = BeginEdit();
+    seq.SetResolution(seq.resolution + 1);
+    EndEdit(); // step start ticks change too
   }
   bool BumpLength() {
-    return get_sequence().BumpLength();
-    stale = true;
+    const bool more = BeginEdit().BumpLength();
+    EndEdit();
+    return more;
+  }
+  // playback transpose, applied by rebuilding the step table
+  void SetTranspose(int8_t semitones) {
+    transpose_ = semitones;
+    dirty_ = true;
+    Recorder::Log(REC_TRANSPOSE, transpose_, octave_shift_);
+  }
+  void NudgeOctaveShift(int dir) {
+    int oct = octave_shift_ + dir;
+    CONSTRAIN(oct, -2, 2);
+    octave_shift_ = oct;
+    dirty_ = true;
+    Recorder::Log(REC_TRANSPOSE, transpose_, octave_shift_);
+  }
+  void SetGenParams(const GenParams &params) {
+    gen = params;
+    rng.Seed(gen.seed);
+    Recorder::Log(REC_RNG, uint8_t(rng.state), uint8_t(rng.state >> 8));
+  }
+  // second lane settings - a new pattern or length picks up at its next step
+  void SetLane(uint8_t p_, uint8_t length, uint8_t div, uint8_t channel) {
+    if (channel > 16) channel = 0;
+    if (channel != lane.channel) lane.Release();
+    lane.pattern = p_ & 0xf;
+    lane.length = (length > MAX_STEPS) ? 0 : length;
+    lane.div = (div < 1) ? 1 : (div > MidiLane::MAX_DIV) ? MidiLane::MAX_DIV : div;
+    lane.channel = channel;
+  }
+  // the arp takes over from the next step, and lets go of its notes when off
+  void SetArp(bool on) {
+    if (on == arp_on_) return;
+    Recorder::Log(REC_ARP, ARP_LOG_ON, on);
+    if (!on) arp.Clear();
+    arp_on_ = on;
+    resting = true; // quiet until the next step
+  }
+  void SetArpOrder(uint8_t o) {
+    Recorder::Log(REC_ARP, ARP_LOG_ORDER, o);
+    arp.SetOrder(o);
+  }
+  void SetArpOctaves(uint8_t n) {
+    Recorder::Log(REC_ARP, ARP_LOG_OCTAVES, n);
+    arp.SetOctaves(n);
+  }
+  // held keys, by semitone - the engine's so they're logged
+  void ArpPress(uint8_t semi) {
+    Recorder::Log(REC_ARP_KEY, semi, 1);
+    arp.Press(semi);
+  }
+  void ArpRelease(uint8_t semi) {
+    Recorder::Log(REC_ARP_KEY, semi, 0);
+    arp.Release(semi);
   }
+  bool get_arp() const { return arp_on_; }
+  void SetCue(uint8_t q) {
+    cue_ = CueQuantum(q < CUE_COUNT ? q : uint8_t(CUE_PATTERN));
+    Recorder::Log(REC_CUE, cue_);
+  }
+  CueQuantum get_cue() const { return cue_; }
   void SetMode(SequencerMode m, bool reset = false) {
     mode_ = m;
     if (reset) Reset();
   }
   void NudgeOctave(int dir) {
-    get_sequence().SetOctave(int(get_sequence().get_octave()) + dir);
+    Sequence &seq = BeginEdit();
+    seq.SetOctave(int(seq.get_octave()) + dir);
+    EndEdit();
   }
   // change pitch, preserving flags
   void SetPitch(uint8_t p) {
-    get_sequence().SetPitch(p);
-    stale = true;
+    BeginEdit().SetPitch(p);
+    EndEdit();
   }
   void SetPitch(uint8_t p, uint8_t flags) {
-    get_sequence().SetPitch(p, flags);
-    stale = true;
+    BeginEdit().SetPitch(p, flags);
+    EndEdit();
   }
   void SetTime(uint8_t t) {
-    get_sequence().SetTime(t);
-    stale = true;
+    BeginEdit().SetTime(t);
+    EndEdit();
+  }
+  // live recording - edit a given time step without moving the playhead
+  void RecordPitch(uint8_t step, uint8_t p) {
+    Sequence &seq = BeginEdit();
+    uint8_t &data = seq.pitch[seq.pitch_index(step)];
+    data = (p & 0x0f) | (data & 0xf0);
+    EndEdit();
+  }
+  void RecordToggle(uint8_t step, uint8_t flag) {
+    Sequence &seq = BeginEdit();
+    seq.pitch[seq.pitch_index(step)] ^= flag;
+    EndEdit();
+  }
+  void RecordOctave(uint8_t step, int dir) {
+    Sequence &seq = BeginEdit();
+    uint8_t &data = seq.pitch[seq.pitch_index(step)];
+    int oct = int(data >> 4 & 0x3) + dir;
+    CONSTRAIN(oct, 0, 3);
+    data = (uint8_t(oct) << 4) | (data & 0xcf);
+    EndEdit();
+  }
+  void RecordTime(uint8_t step, uint8_t t) {
+    BeginEdit().SetTimeAt(step, t);
+    EndEdit();
+  }
+  // 1 to 4 triggers on a time step
+  void CycleRatchet(uint8_t step) {
+    Sequence &seq = BeginEdit();
+    seq.SetRatchetAt(step, seq.ratchet(step) + 1);
+    EndEdit();
+  }
+  // next StepCondition on a time step
+  void CycleCondition(uint8_t step) {
+    Sequence &seq = BeginEdit();
+    seq.SetConditionAt(step, (seq.condition(step) + 1) % COND_COUNT);
+    EndEdit();
   }
 
   void ToggleSlide() {
-    if (mode_ == PITCH_MODE)
-      get_sequence().ToggleSlide();
-    stale = true;
+    if (mode_ != PITCH_MODE) return;
+    BeginEdit().ToggleSlide();
+    EndEdit();
   }
   void ToggleAccent() {
-    if (mode_ == PITCH_MODE)
-      get_sequence().ToggleAccent();
-    stale = true;
+    if (mode_ != PITCH_MODE) return;
+    BeginEdit().ToggleAccent();
+    EndEdit();
   }
 
 };
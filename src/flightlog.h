@@ -0,0 +1,101 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Flight recorder ring - see recorder.h for checkpoints and the dump
+ *
+ * Split out so the engine can log its own actions: a replay applies
+ * those records instead of working out what the panel would have done.
+ * Pattern edits go in as the bytes that changed, XOR'd, so the same
+ * records step the patterns forward or, from a dump, back to a checkpoint.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <util/atomic.h>
+
+enum RecordKind : uint8_t {
+  REC_KEY,       // a = InputIndex, b = 1 pressed, 0 released - not replayed
+  REC_TICK,      // a = engine ticks run, b = source ticks (MIDI clock isn't logged as REC_MIDI)
+  REC_RUN,       // a = running, b = 1 if stopping reset the playhead (DIN RUN)
+  REC_MIDI,      // a = status, b = first data byte
+  REC_SPP,       // a = Song Position low 7 bits, b = high 7 bits
+  REC_OUT,       // a = CV port, b = control port, as committed
+  REC_SELECT,    // a = pattern, b = 1 if it took over right away - Engine::SetPattern()
+  REC_TRANSPOSE, // a = semitones, b = octave shift
+  REC_ARP,       // a = ArpLogged, b = its new value
+  REC_FREEZE,
+  REC_LATE,      // a = 1 a step is held back, 0 its onset came
+  REC_ARP_KEY,   // a = semitone, b = 1 pressed, 0 released
+  REC_RESET,
+  REC_ADVANCE,   // a = 0 a step by hand, 1 the pitch step only
+  REC_EDIT,      // a = pattern, b = REC_EDIT_BYTEs that follow
+  REC_EDIT_BYTE, // a = storage byte, b = XOR of before and after
+  REC_RNG,       // a, b = the engine's rng state, low byte first
+  REC_PRESET,    // a, b = preset number, low byte first - 0xffff stops it
+  REC_CUE,       // a = CueQuantum
+  REC_RATIO,     // a = ClockRatio
+  REC_PUBLISH,   // an edit reached playback
+  REC_PLAYHEAD,  // a = time step, b = pitch step | reset << 7 - a pattern that took over right away
+
+  REC_KIND_COUNT
+};
+
+enum ArpLogged : uint8_t {
+  ARP_LOG_ON,
+  ARP_LOG_ORDER,   // restarts the walk, even when it's the same
+  ARP_LOG_OCTAVES,
+};
+
+// all bytes, so the host sees the same layout
+struct RecordEntry {
+  uint8_t kind, a, b;
+  uint8_t stamp[2]; // Timer1, 4us per count
+};
+
+namespace Recorder {
+  static constexpr uint8_t EDIT_SIZE = 64; // pattern storage bytes
+
+  static RecordEntry ring_[256]; // indexed by a byte, wraps for free
+  static uint8_t head_ = 0;
+  static bool wrapped_ = false;
+  static bool frozen_ = false;
+  static bool edited_frozen_ = false; // patterns changed after the ring stopped
+  static uint8_t before_[EDIT_SIZE];  // the open edit's pattern as it started
+  static uint16_t before_rng_ = 0;
+
+  inline void Log(RecordKind kind, uint8_t a = 0, uint8_t b = 0) {
+    if (frozen_) return;
+    uint16_t t;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      t = TCNT1; // 16-bit read through TEMP, which the Timer1 ISRs also use
+    }
+    RecordEntry &e = ring_[head_];
+    e.kind = kind;
+    e.a = a;
+    e.b = b;
+    e.stamp[0] = uint8_t(t);
+    e.stamp[1] = uint8_t(t >> 8);
+    if (++head_ == 0) wrapped_ = true;
+  }
+
+  // Engine::BeginEdit() / EndEdit() - one REC_EDIT for the bytes in between
+  inline void EditBegin(const uint8_t *data, uint16_t rng) {
+    if (frozen_) return;
+    memcpy(before_, data, EDIT_SIZE);
+    before_rng_ = rng;
+  }
+  inline void EditEnd(uint8_t idx, const uint8_t *data, uint16_t rng) {
+    if (frozen_) {
+      edited_frozen_ = true;
+      return;
+    }
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < EDIT_SIZE; ++i) n += (before_[i] != data[i]);
+    if (n) {
+      Log(REC_EDIT, idx, n);
+      for (uint8_t i = 0; i < EDIT_SIZE; ++i) {
+        if (before_[i] != data[i]) Log(REC_EDIT_BYTE, i, before_[i] ^ data[i]);
+      }
+    }
+    if (rng != before_rng_) Log(REC_RNG, uint8_t(rng), uint8_t(rng >> 8)); // Generate() rolled it
+  }
+} // namespace Recorder
@@ -0,0 +1,68 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Compile-time pin HAL for the AT90USB1286
+ *
+ * Every signal is a type that carries its port and bit, so reads and writes
+ * fold down to single sbi/cbi/sbic instructions with no pin lookup at runtime.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// a register by data-space address - host builds (tools/replay/host) point it at RAM
+#ifndef IO_REG
+#define IO_REG(addr) (*reinterpret_cast<volatile uint8_t *>(addr))
+#endif
+
+// data-space addresses of the PORTx registers - PINx and DDRx sit right below
+enum PortAddress : uint16_t {
+  PORT_B = 0x25,
+  PORT_C = 0x28,
+  PORT_D = 0x2b,
+  PORT_E = 0x2e,
+  PORT_F = 0x31,
+};
+
+template <uint16_t ADDR>
+struct IoPort {
+  static volatile uint8_t &port() { return IO_REG(ADDR); }
+  static volatile uint8_t &ddr() { return IO_REG(ADDR - 1); }
+  static volatile uint8_t &pin() { return IO_REG(ADDR - 2); }
+};
+
+template <uint16_t ADDR, uint8_t BIT>
+struct IoPin {
+  typedef IoPort<ADDR> Port;
+  static constexpr uint8_t mask = 1 << BIT;
+
+  static void High() { Port::port() |= mask; }
+  static void Low() { Port::port() &= uint8_t(~mask); }
+  static void Write(bool high) { if (high) High(); else Low(); }
+  static bool Read() { return Port::pin() & mask; }
+  static void Output() { Port::ddr() |= mask; }
+  static void Input() { Port::ddr() &= uint8_t(~mask); }
+};
+
+// Four pins treated as a nibble, bit 0 = P0. Loops over the group are unrolled
+// at compile time, so each pin access is still a single instruction.
+template <typename P0, typename P1, typename P2, typename P3>
+struct PinGroup {
+  template <uint8_t I, typename Dummy = void> struct At;
+  template <typename Dummy> struct At<0, Dummy> { typedef P0 Pin; };
+  template <typename Dummy> struct At<1, Dummy> { typedef P1 Pin; };
+  template <typename Dummy> struct At<2, Dummy> { typedef P2 Pin; };
+  template <typename Dummy> struct At<3, Dummy> { typedef P3 Pin; };
+
+  static uint8_t Read() {
+    return uint8_t(P0::Read()) | uint8_t(P1::Read()) << 1
+         | uint8_t(P2::Read()) << 2 | uint8_t(P3::Read()) << 3;
+  }
+  static void Write(uint8_t nibble) {
+    P0::Write(nibble & 1);
+    P1::Write(nibble & 2);
+    P2::Write(nibble & 4);
+    P3::Write(nibble & 8);
+  }
+  static void Output() { P0::Output(); P1::Output(); P2::Output(); P3::Output(); }
+  static void Input() { P0::Input(); P1::Input(); P2::Input(); P3::Input(); }
+};
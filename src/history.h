@@ -0,0 +1,115 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Undo / redo for pattern edits
+ *
+ * An edit is kept as the XOR of a pattern's 64 storage bytes before and
+ * after it, with the zero bytes left out - a step edit costs a few bytes,
+ * a cleared or generated pattern at most about a hundred. The same record
+ * undoes and redoes: XOR it in again and the bytes flip back.
+ *
+ * Records sit back to back in a byte-indexed ring, and a new one pushes out
+ * the oldest when it doesn't fit. Each has its length at both ends, so the
+ * cursor can walk either way:
+ *   pattern, body length, body, body length
+ * and the body is runs of
+ *   zero bytes skipped, run length, XOR bytes
+ */
+
+#pragma once
+#include <Arduino.h>
+
+struct EditHistory {
+  static constexpr uint8_t DATA_SIZE = 64; // pattern storage bytes
+  static constexpr uint8_t NONE = 0xff;
+  static constexpr uint8_t OVERHEAD = 3;
+
+  uint8_t ring_[256]; // indexed by a byte, wraps for free
+  uint8_t tail_ = 0;   // oldest record
+  uint8_t cursor_ = 0; // end of the last record applied - undo goes back from here
+  uint8_t head_ = 0;   // end of the newest - redo goes forward to here
+  uint8_t before_[DATA_SIZE]; // the pattern as the open edit found it
+  uint8_t open_ = NONE;       // pattern being edited, or NONE
+
+  uint8_t open() const { return open_; }
+  bool can_undo() const { return cursor_ != tail_; }
+  bool can_redo() const { return cursor_ != head_; }
+  uint8_t used() const { return head_ - tail_; }
+
+  void Open(uint8_t idx, const uint8_t *data) {
+    memcpy(before_, data, DATA_SIZE);
+    open_ = idx;
+  }
+  // the edit's done - record what changed, if anything
+  void Close(const uint8_t *data) {
+    if (open_ == NONE) return;
+    const uint8_t idx = open_;
+    open_ = NONE;
+    const uint8_t len = Encode(data, nullptr);
+    if (!len) return;
+
+    head_ = cursor_; // a new edit drops the redo side
+    while (uint8_t(255 - used()) < len + OVERHEAD) tail_ += ring_[uint8_t(tail_ + 1)] + OVERHEAD;
+    ring_[head_++] = idx;
+    ring_[head_++] = len;
+    Encode(data, ring_);
+    head_ += len;
+    ring_[head_++] = len;
+    cursor_ = head_;
+  }
+
+  // pattern the next Undo() / Redo() changes, NONE if there's nothing
+  uint8_t undo_target() const {
+    return can_undo() ? ring_[uint8_t(cursor_ - ring_[uint8_t(cursor_ - 1)] - OVERHEAD)] : NONE;
+  }
+  uint8_t redo_target() const { return can_redo() ? ring_[cursor_] : NONE; }
+
+  void Undo(uint8_t *data) {
+    if (!can_undo()) return;
+    cursor_ -= ring_[uint8_t(cursor_ - 1)] + OVERHEAD;
+    Apply(data, cursor_);
+  }
+  void Redo(uint8_t *data) {
+    if (!can_redo()) return;
+    Apply(data, cursor_);
+    cursor_ += ring_[uint8_t(cursor_ + 1)] + OVERHEAD;
+  }
+
+  // XOR of before_ and data as runs - to the head of ring, or just measured
+  uint8_t Encode(const uint8_t *data, uint8_t *ring) const {
+    uint8_t len = 0, at = head_;
+    uint8_t i = 0;
+    while (i < DATA_SIZE) {
+      const uint8_t start = i;
+      while (i < DATA_SIZE && before_[i] == data[i]) ++i;
+      if (i == DATA_SIZE) break;
+      const uint8_t skip = i - start;
+      uint8_t run = 0;
+      while (i + run < DATA_SIZE && before_[i + run] != data[i + run]) ++run;
+      if (ring) {
+        ring[at++] = skip;
+        ring[at++] = run;
+        for (uint8_t j = 0; j < run; ++j) ring[at++] = before_[i + j] ^ data[i + j];
+      }
+      len += 2 + run;
+      i += run;
+    }
+    return len;
+  }
+  // flip a record's bytes in data
+  void Apply(uint8_t *data, uint8_t rec) const {
+    const uint8_t len = ring_[uint8_t(rec + 1)];
+    uint8_t at = rec + 2;
+    const uint8_t end = at + len;
+    uint8_t i = 0;
+    while (at != end) {
+      i += ring_[at++];
+      const uint8_t run = ring_[at++];
+      for (uint8_t j = 0; j < run; ++j) data[i++] ^= ring_[at++];
+    }
+  }
+
+  void Clear() {
+    tail_ = cursor_ = head_ = 0;
+    open_ = NONE;
+  }
+};
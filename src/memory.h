@@ -0,0 +1,57 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * SRAM usage instrumentation - stack painting and high-water mark
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// symbols from the avr-libc linker script
+extern uint8_t _end;    // end of .bss, start of heap
+extern uint8_t __stack; // top of RAM
+extern char *__brkval;  // heap top, 0 if malloc was never called
+
+static constexpr uint8_t STACK_CANARY = 0xc5;
+
+// Fill everything between .bss and the stack with the canary before main() runs.
+// Lives in .init1, so no stack frame and no C runtime yet - hence the asm.
+extern "C" void PaintStack(void) __attribute__((naked, used, section(".init1")));
+extern "C" void PaintStack(void) {
+  __asm volatile (
+    "    ldi r30,lo8(_end)\n"
+    "    ldi r31,hi8(_end)\n"
+    "    ldi r24,0xc5\n" // STACK_CANARY
+    "    ldi r25,hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:\n"
+    "    st Z+,r24\n"
+    "2:\n"
+    "    cpi r30,lo8(__stack)\n"
+    "    cpc r31,r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    ::);
+}
+
+namespace Memory {
+  // bytes between the heap and the deepest the stack has ever reached
+  uint16_t Headroom() {
+    const uint8_t *p = __brkval ? (const uint8_t*)__brkval : &_end;
+    uint16_t count = 0;
+    while (p <= &__stack && *p == STACK_CANARY) {
+      ++p;
+      ++count;
+    }
+    return count;
+  }
+  // bytes between the heap and the stack right now
+  uint16_t Free() {
+    uint8_t top;
+    const uint8_t *heap = __brkval ? (const uint8_t*)__brkval : &_end;
+    return &top - heap;
+  }
+  // .data + .bss, fixed at link time
+  uint16_t Static() {
+    return &_end - (uint8_t*)RAMSTART;
+  }
+} // namespace Memory
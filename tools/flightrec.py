@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+
+# Fetch and read OS-303 flight recorder dumps - see src/recorder.h.
+#   flightrec.py /dev/ttyACM0 dump.bin   - pull over USB (freezes the recorder, resumes after)
+#   flightrec.py capture.syx dump.bin    - unpack the SysEx sent by FUNCTION + BACK
+#   flightrec.py dump.bin                - list the events
+# Then tools/replay runs a dump back through the engine.
+
+import struct
+import sys
+
+MAGIC = b"O3FR"
+HEADER_SIZE = 9
+ENTRY_SIZE = 5
+PATTERNS_SIZE = 16 * 64
+STAMP_US = 4
+SYSEX_HEAD = bytes([0xF0, 0x7D, ord("F"), ord("R")])
+CHUNK = 60
+
+KINDS = ["KEY", "TICK", "RUN", "MIDI", "SPP", "OUT", "SELECT", "TRANSPOSE", "ARP", "FREEZE", "LATE",
+         "ARP_KEY", "RESET", "ADVANCE", "EDIT", "EDIT_BYTE", "RNG", "PRESET", "CUE", "RATIO", "PUBLISH",
+         "PLAYHEAD"]
+ARP_SETTINGS = ["on", "order", "octaves"]
+DUMP_EDITED = 0x01
+MIDI_TYPES = {0x80: "NoteOff", 0x90: "NoteOn", 0xB0: "CC", 0xC0: "ProgramChange",
+              0xFA: "Start", 0xFB: "Continue", 0xFC: "Stop"}
+NOTES = ["C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"]
+
+
+def fetch(port):
+    from remote import Remote, CMD_RECORDER
+    remote = Remote(port)
+    data = bytearray()
+    size = None
+    while size is None or len(data) < size:
+        reply = remote.call(CMD_RECORDER, struct.pack("<H", len(data)))
+        size = struct.unpack("<H", reply[:2])[0]
+        if len(reply) <= 2:
+            break
+        data.extend(reply[2:])
+    remote.call(CMD_RECORDER, struct.pack("<H", 0xFFFF))
+    return bytes(data)
+
+
+def unpack_sysex(raw):
+    start = raw.find(SYSEX_HEAD)
+    end = raw.find(b"\xF7", start)
+    if start < 0 or end < 0:
+        raise ValueError("no flight recorder SysEx in the capture")
+    body = raw[start + len(SYSEX_HEAD):end]
+    data = bytearray()
+    for i in range(0, len(body), 8):
+        msbs, group = body[i], body[i + 1:i + 8]
+        for j, b in enumerate(group):
+            data.append(b | ((msbs >> j) & 1) << 7)
+    return bytes(data)
+
+
+def entries(dump):
+    if dump[:4] != MAGIC:
+        raise ValueError("not a flight recorder dump")
+    if dump[8] & DUMP_EDITED:
+        print("patterns were edited after the freeze")
+    count = struct.unpack("<H", dump[6:8])[0]
+    start = len(dump) - count * ENTRY_SIZE
+    for i in range(count):
+        kind, a, b, stamp = struct.unpack("<BBBH", dump[start + i * ENTRY_SIZE:start + (i + 1) * ENTRY_SIZE])
+        yield kind, a, b, stamp
+
+
+def describe(kind, a, b):
+    name = KINDS[kind] if kind < len(KINDS) else "?%d" % kind
+    if name == "KEY":
+        return "KEY       input %2d %s" % (a, "down" if b else "up")
+    if name == "TICK":
+        return "TICK      %d engine, %d source" % (a, b)
+    if name == "RUN":
+        return "RUN       %s%s" % ("started" if a else "stopped", ", reset" if b else "")
+    if name == "MIDI":
+        return "MIDI      %s %d" % (MIDI_TYPES.get(a, "0x%02x" % a), b)
+    if name == "SPP":
+        return "SPP       %d" % (a | b << 7)
+    if name == "OUT":
+        return "OUT       %-3s oct %d  ctrl 0x%02x" % (NOTES[(a & 15) % 12], a >> 4 & 3, b)
+    if name == "SELECT":
+        return "SELECT    pattern %d%s" % (a, " now" if b else "")
+    if name == "TRANSPOSE":
+        return "TRANSPOSE %+d, octave %+d" % struct.unpack("bb", bytes([a, b]))
+    if name == "ARP":
+        return "ARP       %s %d" % (ARP_SETTINGS[a] if a < len(ARP_SETTINGS) else "?", b)
+    if name == "LATE":
+        return "LATE      %s" % ("step held back" if a else "onset")
+    if name == "ARP_KEY":
+        return "ARP_KEY   %-2s %s" % (NOTES[a % 12] if a < 12 else "C'", "down" if b else "up")
+    if name == "ADVANCE":
+        return "ADVANCE   %s" % ("pitch" if a else "step")
+    if name == "EDIT":
+        return "EDIT      pattern %d, %d bytes" % (a, b)
+    if name == "EDIT_BYTE":
+        return "            byte %2d ^ 0x%02x" % (a, b)
+    if name == "RNG":
+        return "RNG       0x%04x" % (a | b << 8)
+    if name == "PRESET":
+        return "PRESET    %s" % ("stop" if a == b == 0xFF else a | b << 8)
+    if name == "CUE":
+        return "CUE       %d" % a
+    if name == "RATIO":
+        return "RATIO     %d" % a
+    if name == "PLAYHEAD":
+        return "PLAYHEAD  step %d, pitch %d%s" % (a, b & 0x7F, ", reset" if b & 0x80 else "")
+    return name
+
+
+def main():
+
+    if len(sys.argv) == 3:
+        source, out = sys.argv[1], sys.argv[2]
+        if source.endswith(".syx"):
+            dump = unpack_sysex(open(source, "rb").read())
+        else:
+            dump = fetch(source)
+        open(out, "wb").write(dump)
+        print("%d bytes -> %s" % (len(dump), out))
+    elif len(sys.argv) == 2:
+        dump = open(sys.argv[1], "rb").read()
+        t = 0
+        last = None
+        for kind, a, b, stamp in entries(dump):
+            if last is not None:
+                t += ((stamp - last) & 0xFFFF) * STAMP_US
+            last = stamp
+            print("%10.3f ms  %s" % (t / 1000.0, describe(kind, a, b)))
+    else:
+        print("usage: flightrec.py <serial port|capture.syx> <dump.bin> | flightrec.py <dump.bin>")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+// Host timing of the pattern generator - see Sequence::RegenPitch() / RegenTime().
+//   g++ -std=gnu++11 -O2 -Itools/replay/host -Isrc tools/genbench.cpp -o genbench
+//   ./genbench
+//
+// Times one generated step (pitch and time, as a held CLEAR + BACK does per
+// clock) with the xorshift generator, and the same draws from a copy of
+// avr-libc's random() it replaced. A PC isn't the AVR, so the ratio is the
+// useful part; the budget line scales it by a rough 16MHz/PC factor against
+// one clock tick at 300bpm.
+
+#include <chrono>
+#include "engine.h"
+
+EEPROMClass storage;
+PersistentSettings GlobalSettings;
+
+static constexpr uint32_t STEPS = 20000000;
+
+// avr-libc random(): Park-Miller minimal standard, 32-bit, via Schrage
+static uint32_t libc_state = 1;
+static long libc_random() {
+  long hi = long(libc_state) / 127773, lo = long(libc_state) % 127773;
+  long x = 16807 * lo - 2836 * hi;
+  if (x < 0) x += 0x7fffffff;
+  libc_state = x;
+  return x;
+}
+
+template <typename F>
+static double time_ns(F step) {
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < STEPS; ++i) step(i);
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / STEPS;
+}
+
+int main() {
+  Sequence seq;
+  seq.Clear();
+  seq.SetLength(MAX_STEPS);
+  GenParams gen;
+  gen.oct_range = 2;
+  Xorshift rng;
+  rng.Seed(303);
+
+  const double step = time_ns([&](uint32_t i) {
+    seq.pitch_pos = seq.time_pos = i & (MAX_STEPS - 1);
+    seq.RegenPitch(rng, gen);
+    seq.RegenTime(rng, gen);
+  });
+  // the draws one step takes: note, octave, accent, slide, density, tie
+  volatile uint32_t sink = 0;
+  const double xs = time_ns([&](uint32_t) {
+    uint32_t sum = 0;
+    for (uint8_t k = 0; k < 6; ++k) sum += rng.Next();
+    sink += sum;
+  });
+  const double libc = time_ns([&](uint32_t) {
+    uint32_t sum = 0;
+    for (uint8_t k = 0; k < 6; ++k) sum += libc_random();
+    sink += sum;
+  });
+
+  // 300bpm at 24ppqn is 8.3ms a tick; a 16MHz AVR runs very roughly 100x slower than this
+  const double tick_ns = 60e9 / 300 / 24;
+  printf("generated step: %.2f ns\n", step);
+  printf("6 draws: xorshift %.2f ns, avr-libc random() %.2f ns (%.1fx)\n", xs, libc, libc / xs);
+  printf("budget: ~%.3f%% of a 300bpm tick at 100x slower\n", step * 100 / tick_ns * 100);
+  return 0;
+}
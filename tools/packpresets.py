@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+
+# Pack a directory of pattern files into the flash preset library, src/presets.h
+#   packpresets.py [presets/] [src/presets.h]
+#
+# Each pattern file is the 64-byte Sequence storage layout, the same bytes
+# remote.py dump writes - so a pattern made on the panel can be pulled off
+# the unit and shipped as a preset. Presets are numbered by sorted filename.
+
+import os
+import sys
+
+PATTERN_SIZE = 64
+MAX_STEPS = 32
+LENGTH_OFFSET = PATTERN_SIZE - 1
+MAX_PRESETS = 512 # keeps the library in the low 64K of flash with the app
+
+
+def load(path):
+    data = open(path, "rb").read()
+    if len(data) != PATTERN_SIZE:
+        raise ValueError("%s: %d bytes, a pattern is %d" % (path, len(data), PATTERN_SIZE))
+    if not 1 <= data[LENGTH_OFFSET] <= MAX_STEPS:
+        raise ValueError("%s: length %d" % (path, data[LENGTH_OFFSET]))
+    return data
+
+
+def main():
+
+    src = sys.argv[1] if len(sys.argv) > 1 else "presets"
+    out = sys.argv[2] if len(sys.argv) > 2 else os.path.join("src", "presets.h")
+
+    names = sorted(f for f in os.listdir(src) if f.endswith(".bin"))
+    if not names:
+        print("no .bin patterns in %s" % src)
+        sys.exit(1)
+    if len(names) > MAX_PRESETS:
+        print("%d patterns, at most %d fit" % (len(names), MAX_PRESETS))
+        sys.exit(1)
+
+    lines = [
+        "// Generated by tools/packpresets.py from %s/ - do not edit" % src,
+        "//",
+        "// Factory patterns in the Sequence storage layout, played in place from flash.",
+        "",
+        "#pragma once",
+        "#include <avr/pgmspace.h>",
+        "",
+        "static constexpr uint16_t PRESET_COUNT = %d;" % len(names),
+        "",
+        "const uint8_t presets[PRESET_COUNT][%d] PROGMEM = {" % PATTERN_SIZE,
+    ]
+    for i, name in enumerate(names):
+        data = load(os.path.join(src, name))
+        lines.append("  // %d: %s" % (i, os.path.splitext(name)[0]))
+        for row in range(0, PATTERN_SIZE, 16):
+            chunk = ", ".join("0x%02x" % b for b in data[row:row + 16])
+            lines.append(("  { " if row == 0 else "    ") + chunk
+                         + (" }," if row + 16 == PATTERN_SIZE else ","))
+    lines.append("};")
+
+    with open(out, "w") as f:
+        f.write("\n".join(lines) + "\n")
+    print("%d presets, %d bytes of flash -> %s" % (len(names), len(names) * PATTERN_SIZE, out))
+
+if __name__ == "__main__":
+    main()
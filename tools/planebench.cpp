@@ -0,0 +1,88 @@
+// Host timing of the bit-plane view against the packed Sequence layout - see StepPlanes.
+//   g++ -std=gnu++11 -O2 -Itools/replay/host -Isrc tools/planebench.cpp -o planebench
+//   ./planebench
+//
+// Per-step queries (accent, slide, tie, rest as heard at a time step) and a
+// rest count on a 32-step pattern, each way. The packed layout has no
+// rotate or reverse of its own - pitches are kept in note order, so moving
+// steps means resolving them per step, which is what Import() does - so
+// those are timed as the plane word ops alone and with the Import/Export
+// round trip RotatePattern() pays. Only the ratios mean anything.
+
+#include <chrono>
+#include "engine.h"
+
+EEPROMClass storage;
+PersistentSettings GlobalSettings;
+
+static constexpr uint32_t ROUNDS = 2000000;
+static volatile uint32_t sink;
+
+template <typename F>
+static double time_ns(F op) {
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ROUNDS; ++i) op(i);
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / ROUNDS;
+}
+
+// the packed layout's answer for time step t - the pitch byte is found by walking notes
+static uint8_t packed_flags(const Sequence &seq, uint8_t t) {
+  const uint8_t data = seq.pitch[seq.pitch_index(t)];
+  const uint8_t tm = seq.time(t);
+  return (data >> 6 & 1) | (data >> 6 & 2)
+       | (seq.time(seq.next_step(t)) == TIME_TIE) << 2 | (tm == 0) << 3;
+}
+
+int main() {
+  Sequence seq;
+  seq.Clear();
+  seq.SetLength(MAX_STEPS);
+  Xorshift rng;
+  GenParams gen;
+  for (uint8_t t = 0; t < MAX_STEPS; ++t) {
+    seq.pitch_pos = seq.time_pos = t;
+    seq.RegenPitch(rng, gen);
+    seq.RegenTime(rng, gen);
+  }
+  StepPlanes planes;
+  planes.Import(seq);
+
+  const double q_packed = time_ns([&](uint32_t i) {
+    uint32_t sum = 0;
+    for (uint8_t t = 0; t < MAX_STEPS; ++t) sum += packed_flags(seq, t);
+    sink += sum + i;
+  });
+  const double q_planes = time_ns([&](uint32_t i) {
+    uint32_t sum = 0;
+    for (uint8_t t = 0; t < MAX_STEPS; ++t)
+      sum += planes.get_accent(t) | planes.get_slide(t) << 1 | planes.is_tied(t) << 2 | planes.is_rest(t) << 3;
+    sink += sum + i;
+  });
+  const double c_packed = time_ns([&](uint32_t i) {
+    uint8_t rests = 0;
+    for (uint8_t t = 0; t < seq.length; ++t) rests += seq.time(t) == 0;
+    sink += rests + i;
+  });
+  const double c_planes = time_ns([&](uint32_t i) { sink += StepPlanes::Count(planes.rests()) + i; });
+  const double trip = time_ns([&](uint32_t) {
+    StepPlanes p;
+    p.Import(seq);
+    p.Export(seq);
+  });
+  const double rot = time_ns([&](uint32_t i) {
+    planes.Rotate(1);
+    sink += planes.note + i;
+  });
+  const double rev = time_ns([&](uint32_t i) {
+    planes.Reverse();
+    sink += planes.note + i;
+  });
+  printf("                      packed    planes\n");
+  printf("32 step queries    %8.1f  %8.1f ns\n", q_packed, q_planes);
+  printf("count rests        %8.1f  %8.1f ns\n", c_packed, c_planes);
+  printf("rotate one step              %8.1f ns\n", rot);
+  printf("reverse                      %8.1f ns\n", rev);
+  printf("Import + Export              %8.1f ns\n", trip);
+  return 0;
+}
@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+
+# Edit OS-303 patterns over USB serial - see src/remote.h for the framing.
+#   remote.py /dev/ttyACM0 state
+#   remote.py /dev/ttyACM0 dump 3 pattern3.bin
+#   remote.py /dev/ttyACM0 run edits.txt   - one command per line, # comments
+#
+# commands:
+#   ping | state | save
+#   dump <pattern> [file]          64 storage bytes, hex to stdout without a file
+#   load <pattern> <file>
+#   step <pattern> <step> [<pitch byte> <time nibble>]
+#   length <pattern> <steps>
+#   select <pattern>
+#   preset <n> | preset off        play a flash preset in place of the pattern
+#   copy <preset> <pattern>        copy a flash preset into a user pattern
+#   cond <pattern> <step|accent|slide> [<condition>]
+#                                  trigger condition on a step, or on every accent or slide:
+#                                  0 always, 1 75%, 2 50%, 3 25%, 4 12%, 5 first pass,
+#                                  6 every 2nd pass, 7 every 4th pass
+#   undo | redo                    last pattern edit, from the panel or from here
+#   nudge <pattern> <step> [<0-15>]
+#                                  play a step late, in 1/32 steps - on top of swing
+#   settings [name=value ...]      seed scale density tie accent slide oct_low oct_range transpose octave cue
+#                                  lane lane_length lane_div lane_channel arp arp_order arp_octaves clock swing
+#                                  cue: 0 step, 1 beat, 2 bar, 3 pattern end
+#                                  lane: second pattern, played to MIDI out on lane_channel (0 off)
+#                                  arp_order: 0 up, 1 down, 2 up-down, 3 random, 4 as played
+#                                  clock: input ratio 0 1:1, 1 x2, 2 x3, 3 x4, 4 /2, 5 /3, 6 /4
+#                                  swing: percent of each step pair the first step gets, 50-75
+
+import struct
+import sys
+import time
+
+SYNC = 0x5A
+REPLY = 0x80
+TELEMETRY_SYNC = 0xA5
+TELEMETRY_SIZE = 7
+PATTERN_SIZE = 64
+
+(CMD_PING, CMD_STATE, CMD_READ_PATTERN, CMD_WRITE_PATTERN, CMD_READ_STEP,
+ CMD_WRITE_STEP, CMD_SET_LENGTH, CMD_READ_SETTINGS, CMD_WRITE_SETTINGS,
+ CMD_SELECT, CMD_SAVE, CMD_PLAY_PRESET, CMD_COPY_PRESET, CMD_RECORDER, CMD_CONDITION,
+ CMD_NUDGE, CMD_UNDO) = range(17)
+NO_PRESET = 0xFFFF
+
+STATUS = ["ok", "bad frame", "bad argument", "busy", "unknown command"]
+RS_BUSY = 3
+BUSY_RETRIES = 20 # an edit waits at most a step for another one to reach playback
+MODES = ["normal", "pitch", "time"]
+RESOLUTIONS = ["1/16", "1/16T", "1/32", "1/8"]
+CONDITIONS = ["always", "75%", "50%", "25%", "12%", "first pass", "every 2nd pass", "every 4th pass"]
+SETTINGS = ["seed", "scale", "density", "tie", "accent", "slide",
+            "oct_low", "oct_range", "transpose", "octave", "cue",
+            "lane", "lane_length", "lane_div", "lane_channel", "arp", "arp_order", "arp_octaves", "clock", "swing"]
+SETTINGS_FORMAT = "<HBBBBBBBbbBBBBBBBBBB"
+
+
+class RemoteError(Exception):
+    pass
+
+
+class BusyError(Exception):
+    pass
+
+
+def frame(cmd, payload=b""):
+    body = bytes([cmd, len(payload)]) + bytes(payload)
+    sum = 0
+    for b in body:
+        sum ^= b
+    return bytes([SYNC]) + body + bytes([sum])
+
+
+class Remote:
+
+    def __init__(self, port):
+        import serial
+        self.port = serial.Serial(port, 115200, timeout=2)
+
+    def read(self, n):
+        data = self.port.read(n)
+        if len(data) < n:
+            raise RemoteError("no reply")
+        return data
+
+    def call(self, cmd, payload=b""):
+        # edits come back busy while another pattern's edit waits for its step
+        for _ in range(BUSY_RETRIES):
+            try:
+                return self.call_once(cmd, payload)
+            except BusyError:
+                if cmd == CMD_SAVE:
+                    raise RemoteError("busy (stop the clock first)")
+                time.sleep(0.02)
+        raise RemoteError("busy")
+
+    def call_once(self, cmd, payload=b""):
+        self.port.write(frame(cmd, payload))
+        while True:
+            b = self.read(1)[0]
+            if b == TELEMETRY_SYNC:
+                self.read(TELEMETRY_SIZE - 1) # not ours, skip the record
+                continue
+            if b != SYNC:
+                continue
+            kind, length = self.read(2)
+            payload = self.read(length)
+            sum = self.read(1)[0]
+            check = kind ^ length
+            for x in payload:
+                check ^= x
+            if check != sum or kind != (cmd | REPLY):
+                raise RemoteError("garbled reply")
+            if payload[0] == RS_BUSY:
+                raise BusyError()
+            if payload[0] != 0:
+                raise RemoteError(STATUS[payload[0]] if payload[0] < len(STATUS) else "status %d" % payload[0])
+            return payload[1:]
+
+    def ping(self):
+        r = self.call(CMD_PING)
+        return "protocol v%d, %s" % (r[0], r[1:].decode())
+
+    def state(self):
+        pat, queued, tpos, ppos, length, res, mode, running, transpose, octave, preset, presets = \
+            struct.unpack("<BBBBBBBBbbHH", self.call(CMD_STATE))
+        return ("pattern %d%s%s  %s  step %d/%d  pitch %d  %s  mode %s  transpose %+d oct %+d  (%d presets)"
+                % (pat, " (next %d)" % queued if queued != pat else "",
+                   " preset %d" % preset if preset != NO_PRESET else "",
+                   "running" if running else "stopped", tpos + 1, length, ppos + 1,
+                   RESOLUTIONS[res & 3], MODES[mode % 3], transpose, octave, presets))
+
+    def read_pattern(self, idx):
+        return self.call(CMD_READ_PATTERN, [idx])[1:]
+
+    def write_pattern(self, idx, data):
+        if len(data) != PATTERN_SIZE:
+            raise RemoteError("a pattern is %d bytes" % PATTERN_SIZE)
+        self.call(CMD_WRITE_PATTERN, bytes([idx]) + bytes(data))
+
+    def read_step(self, idx, step):
+        _, _, pitch, time = self.call(CMD_READ_STEP, [idx, step])
+        return pitch, time
+
+    def write_step(self, idx, step, pitch, time):
+        self.call(CMD_WRITE_STEP, [idx, step, pitch & 0xFF, time & 0x0F])
+
+    def read_settings(self):
+        return dict(zip(SETTINGS, struct.unpack(SETTINGS_FORMAT, self.call(CMD_READ_SETTINGS))))
+
+    def write_settings(self, settings):
+        values = [settings[k] for k in SETTINGS]
+        self.call(CMD_WRITE_SETTINGS, struct.pack(SETTINGS_FORMAT, *values))
+
+
+def number(s):
+    return int(s, 0)
+
+
+def command(remote, args):
+    name, args = args[0], args[1:]
+    if name == "ping":
+        print(remote.ping())
+    elif name == "state":
+        print(remote.state())
+    elif name == "save":
+        remote.call(CMD_SAVE)
+    elif name == "dump":
+        data = remote.read_pattern(number(args[0]))
+        if len(args) > 1:
+            open(args[1], "wb").write(data)
+        else:
+            print(data.hex(" "))
+    elif name == "load":
+        remote.write_pattern(number(args[0]), open(args[1], "rb").read())
+    elif name == "step":
+        idx, step = number(args[0]), number(args[1])
+        if len(args) > 2:
+            remote.write_step(idx, step, number(args[2]), number(args[3]))
+        else:
+            pitch, time = remote.read_step(idx, step)
+            print("pitch 0x%02x  time 0x%x" % (pitch, time))
+    elif name == "length":
+        remote.call(CMD_SET_LENGTH, [number(args[0]), number(args[1])])
+    elif name == "select":
+        remote.call(CMD_SELECT, [number(args[0])])
+    elif name == "preset":
+        preset = NO_PRESET if args[0] == "off" else number(args[0])
+        remote.call(CMD_PLAY_PRESET, struct.pack("<H", preset))
+    elif name == "copy":
+        remote.call(CMD_COPY_PRESET, struct.pack("<HB", number(args[0]), number(args[1])))
+    elif name == "cond":
+        step = {"accent": 32, "slide": 33}.get(args[1])
+        payload = [number(args[0]), number(args[1]) if step is None else step]
+        if len(args) > 2:
+            payload.append(number(args[2]))
+        print(CONDITIONS[remote.call(CMD_CONDITION, payload)[2]])
+    elif name in ("undo", "redo"):
+        idx = remote.call(CMD_UNDO, [name == "redo"])[0]
+        print("nothing to %s" % name if idx == 0xFF else "pattern %d" % idx)
+    elif name == "nudge":
+        payload = [number(a) for a in args[:3]]
+        print("%d/32 step late" % remote.call(CMD_NUDGE, payload)[2])
+    elif name == "settings":
+        settings = remote.read_settings()
+        if args:
+            for arg in args:
+                key, value = arg.split("=")
+                if key not in settings:
+                    raise RemoteError("no setting '%s'" % key)
+                settings[key] = number(value)
+            remote.write_settings(settings)
+        else:
+            print("  ".join("%s=%d" % (k, settings[k]) for k in SETTINGS))
+    else:
+        raise RemoteError("unknown command '%s'" % name)
+
+
+def main():
+
+    if len(sys.argv) < 3:
+        print("usage: remote.py <serial port> <command> [args...]")
+        return
+
+    remote = Remote(sys.argv[1])
+    try:
+        if sys.argv[2] == "run":
+            for line in open(sys.argv[3]):
+                args = line.split("#")[0].split()
+                if args:
+                    command(remote, args)
+        else:
+            command(remote, sys.argv[2:])
+    except RemoteError as e:
+        print("error: %s" % e)
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
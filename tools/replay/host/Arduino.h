@@ -0,0 +1,138 @@
+// Just enough of the Teensy core to build the sequencer on a PC, for tools/replay
+// and tools/enginefuzz. Registers are plain memory, time is whatever the tool
+// sets host_us to, and the serial ports go nowhere - the USB one reads what the
+// tool feeds it. One translation unit only.
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+
+typedef uint8_t byte;
+
+volatile uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+volatile uint8_t PINA, PINB, PINC, PIND, PINE, PINF;
+volatile uint8_t DDRA, DDRB, DDRC, DDRD, DDRE, DDRF;
+volatile uint8_t SREG, TCCR1A, TCCR1B, TIMSK1, TIFR1, TCCR3A, TCCR3B, TIMSK3, TIFR3;
+volatile uint8_t PCICR, PCMSK0, PCIFR, EICRA, EICRB, EIMSK, EIFR;
+volatile uint8_t TCCR0A, TCCR0B, TCNT0, TIMSK0, OCR0A, UDR1, UCSR1A, UCSR1B;
+volatile uint16_t OCR1A, OCR1B, OCR1C, TCNT1, OCR3A, OCR3B, TCNT3, ICR1;
+
+// the pin HAL's ports, by data-space address - see hal.h
+volatile uint8_t host_io[0x100];
+#define IO_REG(addr) (host_io[addr])
+
+#define F_CPU 16000000UL
+#define RAMSTART 0x100
+#define RAMEND 0x20FF
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define UDRE1 5
+#define UDRIE1 5
+#define WGM12 3
+#define WGM32 3
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define CS30 0
+#define CS31 1
+#define CS32 2
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCIE1C 3
+#define OCIE3A 1
+#define OCIE3B 2
+#define OCF1A 1
+#define OCF1B 2
+#define OCF1C 3
+#define OCF3A 1
+#define ICES1 6
+#define ICIE1 5
+#define PCIE0 0
+#define PCIF0 0
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define INT0 0
+#define INT1 1
+#define INT6 6
+#define INT7 7
+#define INTF7 7
+#define _BV(b) (1 << (b))
+#define ISR(v) extern "C" void v(void)
+
+inline void cli() {}
+inline void sei() {}
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline void digitalWriteFast(uint8_t, uint8_t) {}
+inline uint8_t digitalRead(uint8_t) { return 0; }
+inline uint8_t digitalReadFast(uint8_t) { return 0; }
+unsigned long host_us = 0;
+inline void delay(unsigned long) {}
+inline void delayMicroseconds(unsigned int) {}
+inline unsigned long millis() { return host_us / 1000; }
+inline unsigned long micros() { return host_us; }
+
+template <class T, class L, class H> T constrain(T x, L lo, H hi) { return x < lo ? lo : (x > hi ? hi : x); }
+
+struct elapsedMillis {
+  unsigned long start;
+  elapsedMillis(unsigned long v = 0) : start(millis() - v) {}
+  operator unsigned long() const { return millis() - start; }
+  elapsedMillis &operator=(unsigned long v) { start = millis() - v; return *this; }
+};
+struct elapsedMicros {
+  unsigned long start;
+  elapsedMicros(unsigned long v = 0) : start(micros() - v) {}
+  operator unsigned long() const { return micros() - start; }
+  elapsedMicros &operator=(unsigned long v) { start = micros() - v; return *this; }
+};
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+struct Print {
+  size_t write(uint8_t) { return 1; }
+  size_t write(const uint8_t *, size_t n) { return n; }
+  size_t print(const char *) { return 0; }
+  size_t print(const __FlashStringHelper *) { return 0; }
+  size_t print(long, int = 10) { return 0; }
+  size_t println(const char *) { return 0; }
+  size_t println(const __FlashStringHelper *) { return 0; }
+  size_t println(long, int = 10) { return 0; }
+  size_t println() { return 0; }
+  int printf(const char *, ...) { return 0; }
+};
+struct usb_serial_class : Print {
+  uint8_t rx_[256];
+  uint8_t rx_head_ = 0, rx_tail_ = 0;
+  bool feed(uint8_t b) { // host side
+    if (uint8_t(rx_tail_ + 1) == rx_head_) return false;
+    rx_[rx_tail_++] = b;
+    return true;
+  }
+
+  void begin(long) {}
+  int available() { return uint8_t(rx_tail_ - rx_head_); }
+  int read() { return rx_head_ == rx_tail_ ? -1 : rx_[rx_head_++]; }
+  int peek() { return rx_head_ == rx_tail_ ? -1 : rx_[rx_head_]; }
+  int availableForWrite() { return 64; }
+  void flush() {}
+  void send_now() {}
+  operator bool() { return false; }
+};
+struct HardwareSerial : Print {
+  void begin(long) {}
+  int available() { return 0; }
+  int read() { return -1; }
+  int availableForWrite() { return 64; }
+  void flush() {}
+};
+usb_serial_class Serial;
+HardwareSerial Serial1;
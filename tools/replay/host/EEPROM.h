@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+
+// nothing is kept - the replay loads patterns from the dump
+struct EEPROMClass {
+  template <class T> T &get(int, T &t) { return t; }
+  template <class T> const T &put(int, const T &t) { return t; }
+  uint8_t read(int) { return 0xff; }
+  void update(int, uint8_t) {}
+  void write(int, uint8_t) {}
+  uint16_t length() { return 4096; }
+};
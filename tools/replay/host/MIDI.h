@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+
+// The Arduino MIDI Library, as far as the sequencer uses it. Messages the
+// host tool queues with Queue() come out of read() one at a time; anything
+// sent goes nowhere.
+#define MIDI_CHANNEL_OMNI 0
+
+namespace midi {
+  enum MidiType : uint8_t {
+    InvalidType = 0x00,
+    NoteOff = 0x80,
+    NoteOn = 0x90,
+    ControlChange = 0xb0,
+    ProgramChange = 0xc0,
+    SystemExclusive = 0xf0,
+    SongPosition = 0xf2,
+    Clock = 0xf8,
+    Start = 0xfa,
+    Continue = 0xfb,
+    Stop = 0xfc,
+  };
+
+  struct Message {
+    MidiType type;
+    uint8_t data1, data2;
+  };
+
+  template <class Port>
+  struct MidiInterface {
+    Message in_[256];
+    uint8_t in_head_ = 0, in_tail_ = 0;
+    Message msg_ = {};
+    bool thru_ = true;
+
+    explicit MidiInterface(Port &) {}
+    bool Queue(MidiType type, uint8_t data1 = 0, uint8_t data2 = 0) { // host side
+      if (uint8_t(in_tail_ + 1) == in_head_) return false;
+      in_[in_tail_++] = Message{ type, uint8_t(data1 & 0x7f), uint8_t(data2 & 0x7f) };
+      return true;
+    }
+
+    void begin(uint8_t) {}
+    bool read() {
+      if (in_head_ == in_tail_) return false;
+      msg_ = in_[in_head_++];
+      return true;
+    }
+    MidiType getType() const { return msg_.type; }
+    uint8_t getData1() const { return msg_.data1; }
+    uint8_t getData2() const { return msg_.data2; }
+    void sendNoteOn(uint8_t, uint8_t, uint8_t) {}
+    void sendNoteOff(uint8_t, uint8_t, uint8_t) {}
+    void turnThruOn() { thru_ = true; }
+    void turnThruOff() { thru_ = false; }
+  };
+} // namespace midi
+
+#define MIDI_CREATE_INSTANCE(Type, SerialPort, Name) midi::MidiInterface<Type> Name(SerialPort);
@@ -0,0 +1,5 @@
+#pragma once
+
+// single-threaded on the host
+#define ATOMIC_BLOCK(x) for (int atomic_once_ = 1; atomic_once_; atomic_once_ = 0)
+#define ATOMIC_RESTORESTATE 0
@@ -0,0 +1,307 @@
+// Replay a flight recorder dump through the sequencer - see src/recorder.h.
+//   g++ -std=gnu++11 -O2 -Itools/replay/host -Isrc tools/replay/replay.cpp -o replay
+//   ./replay dump.bin [-v]
+//
+// The engine starts from the dump's checkpoint and is fed what the firmware
+// logged, in order: ticks, RUN and MIDI, and the engine's own records of
+// what it was told to do - edits, resets, pattern and preset changes, arp
+// keys. Nothing here works out what a key would have done. Each port write
+// made while running is compared with the engine; -v lists them all. Exits 1
+// at the first divergence.
+//
+// The dump has the patterns as they were at the end. Every edit is logged
+// as the bytes it changed, XOR'd, so taking them back off, newest first,
+// gives the patterns the checkpoint saw.
+//
+// While a swung or nudged step is held back the ports keep the last one,
+// so those writes aren't compared; the onset is replayed where it was logged.
+
+#include <vector>
+#include "engine.h"
+#include "recorder.h"
+
+EEPROMClass storage;
+PersistentSettings GlobalSettings;
+
+static Engine engine;
+
+// MIDI status bytes, as logged
+static constexpr uint8_t midi_start = 0xfa, midi_stop = 0xfc;
+
+static const char *note_names[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+static void print_out(uint8_t cv, uint8_t ctrl) {
+  printf("%-2s%u %c%c%c", note_names[(cv & 0xf) % 12], (cv >> 4) & 3,
+         (ctrl & DAC::GATE_BIT) ? 'G' : '.', (ctrl & DAC::ACCENT_BIT) ? 'A' : '.',
+         (ctrl & DAC::SLIDE_BIT) ? 'S' : '.');
+}
+
+// the edit at entries[i], or how many entries it has when they run out
+static uint16_t edit_size(const RecordEntry *entries, uint16_t i, uint16_t count) {
+  uint16_t n = 1;
+  while (n <= entries[i].b && i + n < count && entries[i + n].kind == REC_EDIT_BYTE) ++n;
+  return n;
+}
+
+// dumped patterns -> as they were at entry first
+static bool unwind(uint8_t *patterns, const RecordEntry *entries, uint16_t first, uint16_t count) {
+  std::vector<uint16_t> edits;
+  for (uint16_t i = first; i < count; ++i) {
+    if (entries[i].kind == REC_FREEZE) break;
+    if (entries[i].kind != REC_EDIT) continue;
+    if (entries[i].a >= NUM_PATTERNS || edit_size(entries, i, count) != entries[i].b + 1u) return false;
+    edits.push_back(i);
+  }
+  for (size_t n = edits.size(); n-- > 0;) {
+    const RecordEntry &e = entries[edits[n]];
+    for (uint8_t k = 1; k <= e.b; ++k) {
+      const RecordEntry &d = entries[edits[n] + k];
+      if (d.a >= PATTERN_SIZE) return false;
+      patterns[e.a * PATTERN_SIZE + d.a] ^= d.b;
+    }
+  }
+  return true;
+}
+
+static void restore(const Checkpoint &cp, const uint8_t *patterns) {
+  for (uint8_t i = 0; i < NUM_PATTERNS; ++i)
+    memcpy(engine.pattern(i).pitch, patterns + i * PATTERN_SIZE, PATTERN_SIZE);
+  engine.p_select = cp.p_select;
+  engine.next_p = cp.next_p;
+  Sequence &seq = engine.get_sequence();
+  seq.time_pos = cp.time_pos;
+  seq.pitch_pos = cp.pitch_pos;
+  seq.reset = cp.reset;
+  engine.clk_count = cp.clk_count;
+  engine.bar_tick_ = cp.bar_tick;
+  engine.timing_ = cp.timing;
+  engine.cue_ = CueQuantum(cp.cue);
+  engine.slide_on = cp.slide_on;
+  engine.resting = cp.resting;
+  engine.transpose_ = cp.transpose;
+  engine.octave_shift_ = cp.octave_shift;
+  engine.preset_ = int16_t(cp.preset[0] | cp.preset[1] << 8);
+  engine.rng.state = cp.rng[0] | cp.rng[1] << 8;
+  engine.loops_ = cp.loops[0] | cp.loops[1] << 8;
+  engine.mute_ = cp.mute;
+  engine.arp_on_ = cp.arp_on;
+  engine.arp_out_.cv = cp.arp_cv;
+  engine.arp_out_.ctrl = cp.arp_ctrl;
+  engine.arp_out_.flags = cp.arp_flags;
+  engine.arp = cp.arp;
+  engine.lane = cp.lane;
+  ClockScaler::SetRatio(cp.ratio);
+  ClockScaler::phase_ = cp.phase;
+  engine.lag_ = cp.lag;
+  engine.Compile();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: replay <dump.bin> [-v]\n");
+    return 2;
+  }
+  const bool verbose = argc > 2 && !strcmp(argv[2], "-v");
+
+  FILE *f = fopen(argv[1], "rb");
+  if (!f) {
+    perror(argv[1]);
+    return 2;
+  }
+  std::vector<uint8_t> dump;
+  for (int c; (c = fgetc(f)) != EOF;) dump.push_back(uint8_t(c));
+  fclose(f);
+
+  if (dump.size() < Recorder::HEADER_SIZE || memcmp(dump.data(), "O3FR", 4)) {
+    fprintf(stderr, "not a flight recorder dump\n");
+    return 2;
+  }
+  if (dump[4] != Recorder::VERSION) {
+    fprintf(stderr, "dump version %u, this replay reads %u\n", dump[4], Recorder::VERSION);
+    return 2;
+  }
+  const uint8_t oldest = dump[5];
+  const uint16_t count = dump[6] | dump[7] << 8;
+  const uint8_t flags = dump[8];
+  const size_t entries_at = Recorder::HEADER_SIZE + sizeof(Checkpoint) + Recorder::PATTERNS_SIZE;
+  if (dump.size() != entries_at + count * Recorder::ENTRY_SIZE) {
+    fprintf(stderr, "dump is %zu bytes, expected %zu\n", dump.size(), entries_at + count * Recorder::ENTRY_SIZE);
+    return 2;
+  }
+
+  Checkpoint cp;
+  memcpy(&cp, &dump[Recorder::HEADER_SIZE], sizeof(cp));
+  const RecordEntry *entries = reinterpret_cast<const RecordEntry *>(&dump[entries_at]);
+  const uint16_t first = uint8_t(cp.at - oldest);
+  if (!cp.valid || first >= count) {
+    fprintf(stderr, "no checkpoint inside the dump - nothing to replay from\n");
+    return 2;
+  }
+  for (uint16_t i = first; i < count; ++i) {
+    if (entries[i].kind >= REC_KIND_COUNT) {
+      fprintf(stderr, "bad entry %u, kind %u\n", i, entries[i].kind);
+      return 2;
+    }
+  }
+  uint8_t *patterns = &dump[Recorder::HEADER_SIZE + sizeof(Checkpoint)];
+  if (!unwind(patterns, entries, first, count)) {
+    fprintf(stderr, "a pattern edit in the dump is cut short\n");
+    return 2;
+  }
+  if (flags & Recorder::DUMP_EDITED)
+    printf("warning: patterns were edited after the freeze - expect a divergence\n");
+  restore(cp, patterns);
+  printf("checkpoint at entry %u of %u: pattern %u step %u, %s\n", first, count,
+         cp.p_select, cp.time_pos, cp.running ? "running" : "stopped");
+
+  bool running = cp.running;
+  bool late = cp.late; // a step's onset is held back
+  uint32_t us = 0;
+  uint16_t last_stamp = 0;
+  uint32_t writes = 0, compared = 0;
+
+  if (verbose) printf("   time      recorded  replayed\n");
+  for (uint16_t i = first; i < count; ++i) {
+    const RecordEntry &e = entries[i];
+    const uint16_t stamp = e.stamp[0] | e.stamp[1] << 8;
+    if (i > first) us += uint16_t(stamp - last_stamp) * ClockScaler::US_PER_COUNT;
+    last_stamp = stamp;
+
+    switch (e.kind) {
+      case REC_RUN:
+        running = e.a;
+        if (e.b) { // DIN RUN fell - the engine's reset is its own record
+          ClockScaler::Reset();
+          late = false;
+        }
+        break;
+
+      case REC_MIDI:
+        if (e.a == midi_start) {
+          ClockScaler::Reset();
+          late = false;
+        } else if (e.a == midi_stop) {
+          engine.lane.Release();
+          ClockScaler::Cancel();
+          late = false;
+        }
+        break; // Program Change is logged as what it did
+
+      case REC_SPP:
+        engine.Relocate(ClockScaler::Locate(uint32_t(e.a | e.b << 7) * 6));
+        late = false;
+        break;
+
+      case REC_TICK:
+        for (uint8_t n = running ? e.a : 0; n > 0; --n) engine.Clock();
+        break;
+
+      case REC_LATE:
+        late = e.a;
+        if (!late) engine.Onset();
+        break;
+
+      case REC_OUT: {
+        ++writes;
+        if (!running || late) break;
+        ++compared;
+        const uint8_t cv = engine.get_cv(), ctrl = engine.get_ctrl();
+        const bool match = (cv == e.a && ctrl == e.b);
+        if (verbose) {
+          printf("%10.3f ms  ", us / 1000.0);
+          print_out(e.a, e.b);
+          printf("  ");
+          print_out(cv, ctrl);
+          printf("%s\n", match ? "" : "  <-");
+        }
+        if (!match) {
+          printf("diverged at %.3f ms, entry %u: recorded ", us / 1000.0, i);
+          print_out(e.a, e.b);
+          printf(", replayed ");
+          print_out(cv, ctrl);
+          printf(" (pattern %u step %u)\n", engine.get_patsel(), engine.get_time_pos());
+          return 1;
+        }
+        break;
+      }
+
+      case REC_SELECT:
+        engine.SetPattern(e.a, e.b);
+        break;
+
+      case REC_TRANSPOSE:
+        engine.SetTranspose(int8_t(e.a));
+        engine.octave_shift_ = int8_t(e.b);
+        break;
+
+      case REC_ARP:
+        if (e.a == ARP_LOG_ON) engine.SetArp(e.b);
+        else if (e.a == ARP_LOG_ORDER) engine.SetArpOrder(e.b);
+        else if (e.a == ARP_LOG_OCTAVES) engine.SetArpOctaves(e.b);
+        break;
+
+      case REC_ARP_KEY:
+        if (e.b) engine.ArpPress(e.a);
+        else engine.ArpRelease(e.a);
+        break;
+
+      case REC_RESET:
+        engine.Reset();
+        break;
+
+      case REC_ADVANCE:
+        if (e.a) engine.StepPitch();
+        else engine.Step();
+        break;
+
+      case REC_EDIT: {
+        uint8_t *data = engine.BeginEdit(e.a).pitch; // all 64 bytes
+        for (uint8_t k = 0; k < e.b; ++k, ++i) {
+          const RecordEntry &d = entries[i + 1];
+          data[d.a] ^= d.b;
+        }
+        engine.EndEdit();
+        break;
+      }
+
+      case REC_RNG:
+        engine.rng.state = e.a | e.b << 8;
+        break;
+
+      case REC_PRESET:
+        if (e.a == 0xff && e.b == 0xff) engine.StopPreset();
+        else engine.PlayPreset(e.a | e.b << 8);
+        break;
+
+      case REC_CUE:
+        engine.SetCue(e.a);
+        break;
+
+      case REC_RATIO:
+        ClockScaler::SetRatio(e.a);
+        break;
+
+      case REC_PUBLISH:
+        engine.Publish();
+        break;
+
+      case REC_PLAYHEAD: {
+        Sequence &seq = engine.get_sequence();
+        seq.time_pos = e.a;
+        seq.pitch_pos = e.b & 0x7f;
+        seq.reset = e.b >> 7;
+        break;
+      }
+
+      case REC_FREEZE:
+        i = count - 1;
+        break;
+
+      default: // REC_KEY - the records above are what the keys did
+        break;
+    }
+  }
+
+  printf("%u port writes, %u compared while running over %.3f ms - output matches\n",
+         writes, compared, us / 1000.0);
+  return 0;
+}
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+
+# Decode OS-303 binary telemetry from USB serial (or a captured file).
+#   telemetry.py /dev/ttyACM0     - live, needs pyserial
+#   telemetry.py capture.bin      - offline
+
+import os
+import struct
+import sys
+
+SYNC = 0xA5
+RECORD_SIZE = 7
+REMOTE_SYNC = 0x5A # remote.py reply frames share the port
+STAMP_US = 16
+
+EVENTS = [
+    "BOOT",
+    "CLOCK",
+    "STEP",
+    "PATTERN",
+    "LOAD",
+    "SAVE",
+    "SAVE_DONE",
+    "OVERFLOW",
+    "MEMORY",
+    "RUN",
+    "FAULT",
+    "COMMITS",
+]
+MEMORY_FIELDS = ["static", "free", "stack headroom"]
+
+
+def describe(kind, arg, value):
+    name = EVENTS[kind]
+    if name == "CLOCK":
+        return "CLOCK     pos=%2d  period=%d us" % (arg, value * STAMP_US)
+    if name == "STEP":
+        return "STEP      step=%2d  pattern=%d" % (arg, value)
+    if name == "PATTERN":
+        return "PATTERN   %d" % arg
+    if name == "LOAD":
+        return "LOAD      %s" % ("ok" if arg else "EEPROM invalid, initialized")
+    if name == "BOOT":
+        return "BOOT      build %04x" % value
+    if name == "SAVE":
+        if value == 1:
+            return "SAVE      pattern %d" % (arg + 1)
+        return "SAVE      %d patterns" % value
+    if name == "SAVE_DONE":
+        return "SAVE_DONE %d ms" % value
+    if name == "OVERFLOW":
+        return "OVERFLOW  %d records dropped" % value
+    if name == "MEMORY":
+        return "MEMORY    %s = %d bytes" % (MEMORY_FIELDS[arg % 3], value)
+    if name == "FAULT":
+        faults = [f for bit, f in ((1, "pattern"), (2, "queued pattern"), (4, "length/position")) if arg & bit]
+        return "FAULT     pattern %d repaired: %s" % (value, ", ".join(faults))
+    if name == "COMMITS":
+        return "COMMITS   %d DAC commits/s" % value
+    if name == "RUN":
+        return "RUN       %s" % ("started" if arg else "stopped")
+    return name
+
+
+def decode(read):
+    """Yield (stamp, kind, arg, value) from a byte source, resyncing on junk."""
+    buf = bytearray()
+    while True:
+        chunk = read()
+        if not chunk:
+            return
+        buf.extend(chunk)
+        while len(buf) >= RECORD_SIZE:
+            if buf[0] == REMOTE_SYNC:
+                # 0x5A, cmd, len, payload, checksum
+                if len(buf) < 4 + buf[2]:
+                    break
+                del buf[:4 + buf[2]]
+                continue
+            if buf[0] != SYNC or buf[1] >= len(EVENTS):
+                del buf[0]
+                continue
+            _, kind, arg, value, stamp = struct.unpack("<BBBHH", bytes(buf[:RECORD_SIZE]))
+            del buf[:RECORD_SIZE]
+            yield stamp, kind, arg, value
+
+
+def main():
+
+    if len(sys.argv) < 2:
+        print("usage: telemetry.py <serial port | capture file>")
+        return
+
+    path = sys.argv[1]
+    if os.path.isfile(path):
+        f = open(path, "rb")
+        read = lambda: f.read(256)
+    else:
+        import serial
+        port = serial.Serial(path, 115200, timeout=None) # block for data
+        read = lambda: port.read(max(1, port.in_waiting))
+
+    last = None
+    for stamp, kind, arg, value in decode(read):
+        # stamps wrap every ~1s, so show the delta
+        delta = 0 if last is None else ((stamp - last) & 0xFFFF) * STAMP_US
+        last = stamp
+        print("+%7d us  %s" % (delta, describe(kind, arg, value)))
+        sys.stdout.flush()
+
+if __name__ == "__main__":
+    main()